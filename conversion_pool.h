@@ -0,0 +1,103 @@
+#ifndef CONVERSION_POOL_H
+#define CONVERSION_POOL_H
+
+#include <QMutex>
+#include <QMutexLocker>
+#include <QThread>
+#include <QWaitCondition>
+
+#include <algorithm>
+#include <atomic>
+#include <deque>
+#include <functional>
+#include <future>
+#include <memory>
+#include <thread>
+#include <type_traits>
+#include <vector>
+
+//plain fixed-size worker pool for the cpu heavy part of frame loading,
+//reading from the OpenNI streams stays on its own thread since it has to be sequential
+class ConversionPool {
+    std::vector<std::thread> workers;//worker i runs while i < workerTarget
+    std::deque<std::function<void()>> tasks;
+    std::atomic<size_t> workerTarget;
+    QMutex workersAccess;//resizing, submitting never takes it
+    QMutex queueMutex;
+    QWaitCondition queueChanged;
+    bool stopping;
+
+    void workerLoop(size_t id){
+        while(true){
+            std::function<void()> task;
+            {
+                QMutexLocker locker(&queueMutex);
+                while(!stopping && tasks.empty() && id < workerTarget)
+                    queueChanged.wait(&queueMutex);
+                if(!stopping && id >= workerTarget)
+                    return;//retired, the workers left take the queue over
+                if(tasks.empty())
+                    return;//stopping, and everything queued is done
+                task = std::move(tasks.front());
+                tasks.pop_front();
+            }
+            task();
+        }
+    }
+    //workers past the new count finish the task they're on and leave, the queue keeps going meanwhile
+    void resizeWorkers(size_t count){
+        QMutexLocker resizing(&workersAccess);
+        {
+            QMutexLocker locker(&queueMutex);
+            workerTarget = count;
+            queueChanged.wakeAll();
+        }
+        for(size_t i=count;i<workers.size();i++)
+            workers[i].join();
+        if(workers.size() > count)
+            workers.resize(count);
+        for(size_t i=workers.size();i<count;i++)
+            workers.emplace_back([this, i](){ workerLoop(i); });
+    }
+    void stopWorkers(){
+        QMutexLocker resizing(&workersAccess);
+        {
+            QMutexLocker locker(&queueMutex);
+            stopping = true;
+            queueChanged.wakeAll();
+        }
+        for(auto& worker: workers)
+            worker.join();
+        workers.clear();
+    }
+public:
+    static size_t defaultThreadCount(){
+        return size_t(std::max<int>(1, QThread::idealThreadCount()));
+    }
+    explicit ConversionPool(size_t threadCount = defaultThreadCount()): workerTarget(0), stopping(false) {
+        resizeWorkers(std::max<size_t>(threadCount, 1));
+    }
+    ~ConversionPool(){
+        stopWorkers();
+    }
+    //safe while tasks are queued or running from other threads, none of them is dropped or waited for
+    void setThreadCount(size_t threadCount){
+        resizeWorkers(std::max<size_t>(threadCount, 1));
+    }
+    size_t threadCount() const{
+        return workerTarget;
+    }
+    template<typename Func>
+    std::future<std::invoke_result_t<Func>> submit(Func func){
+        auto task = std::make_shared<std::packaged_task<std::invoke_result_t<Func>()>>(std::move(func));
+        auto result = task->get_future();
+        {
+            QMutexLocker locker(&queueMutex);
+            tasks.emplace_back([task](){ (*task)(); });
+            queueChanged.wakeOne();
+        }
+        return result;
+    }
+};
+
+#endif // CONVERSION_POOL_H
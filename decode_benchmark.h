@@ -0,0 +1,128 @@
+#ifndef DECODE_BENCHMARK_H
+#define DECODE_BENCHMARK_H
+
+#include <QMutexLocker>
+#include <QString>
+
+#include <algorithm>
+#include <chrono>
+#include <future>
+#include <vector>
+
+#include "device_vstream_info.h"
+#include "pixel_converter.h"
+
+//depth decoding of the opened file, native decoder against OpenNI's OniFile driver. the compressed payloads
+//are read up front, so the native numbers are decoding only: once on one thread, once across the pool.
+//OpenNI can't be split like that, its numbers are seek + readFrame, which is what playback through it costs.
+//pixel format conversion is measured apart from any file, see runFormats
+class DecodeBenchmark {
+public:
+    struct result{
+        size_t frames = 0;
+        size_t threads = 0;
+        double nativeSingleMs = 0;//whole run
+        double nativePoolMs = 0;
+        size_t openniFrames = 0;
+        double openniMs = 0;
+        bool failed = false;
+        double framesPerSecond(double ms, size_t count) const{
+            return ms > 0 ? count*1000./ms : 0.;
+        }
+    };
+    struct formatResult{
+        const char* name = "";
+        bool converted = false;//false for the formats that are only copied
+        double msPerFrame = 0;
+        double megapixelsPerSecond = 0;
+    };
+
+    static result run(deviceVStreamInfo& source, size_t wantedFrames){
+        using clock = std::chrono::steady_clock;
+        auto msSince = [](clock::time_point start){
+            return std::chrono::duration<double, std::milli>(clock::now() - start).count();
+        };
+        result measured;
+        if(!source.nativeDepth || !source.servesNatively())
+            return measured;
+        const auto& stream = *source.nativeDepth;
+        std::vector<rawVideoFrame> frames(std::min(wantedFrames, stream.frames.size()));
+        for(size_t index=0;index<frames.size();index++)
+            if(!source.readNativeFrame(stream, index, frames[index]))
+                frames.resize(index);
+        measured.frames = frames.size();
+        measured.threads = source.conversionPool.threadCount();
+        if(frames.empty())
+            return measured;
+        const size_t pixels = size_t(stream.width)*stream.height;
+
+        std::vector<uint16_t> target(pixels);
+        auto start = clock::now();
+        for(auto& frame: frames)
+            measured.failed |= frame.isCompressed() && !frame.expandDepth(target.data());
+        measured.nativeSingleMs = msSince(start);
+
+        std::vector<std::future<bool>> decoded;
+        start = clock::now();
+        for(auto& frame: frames)
+            decoded.push_back(source.conversionPool.submit([&frame, pixels](){
+                std::vector<uint16_t> own(pixels);
+                return !frame.isCompressed() || frame.expandDepth(own.data());
+            }));
+        for(auto& done: decoded)
+            measured.failed |= !done.get();
+        measured.nativePoolMs = msSince(start);
+
+        QMutexLocker locker(&source.streamAccess);
+        if(!source.playbackControl || !source.depthStream->isValid())
+            return measured;
+        //replay is throttled to the recorded rate otherwise, that would be measured instead of the decoding
+        const float speed = source.playbackControl->getSpeed();
+        source.playbackControl->setSpeed(-1);
+        start = clock::now();
+        if(source.playbackControl->seek(*source.depthStream, deviceVStreamInfo::oniFirstFrameIndex) == openni::STATUS_OK){
+            openni::VideoFrameRef frame;
+            while(measured.openniFrames < measured.frames && source.depthStream->readFrame(&frame) == openni::STATUS_OK)
+                measured.openniFrames++;
+        }
+        measured.openniMs = msSince(start);
+        source.playbackControl->setSpeed(speed);
+        source.streamPosition = -1;//the next read has to seek
+        return measured;
+    }
+    //every PixelConverter format over the same synthetic frame, one thread, no file needed.
+    //the values stay within 11 bits so shift formats hit their table like real data does
+    static std::vector<formatResult> runFormats(int width, int height, int rounds){
+        using clock = std::chrono::steady_clock;
+        std::vector<uint16_t> values(size_t(width)*height*2);
+        uint32_t seed = 12345;
+        for(auto& value: values){
+            seed = seed*1664525u + 1013904223u;
+            value = uint16_t((seed >> 16) & 0x7ff);
+        }
+        auto source = reinterpret_cast<const uchar*>(values.data());
+        std::vector<uchar> target(size_t(width)*height*3);
+        const auto table = PixelConverter::shiftToDepthTable(PixelConverter::shiftParameters());
+        PixelConverter::context state;
+        state.shiftToDepth = table.data();
+        state.shiftToDepthSize = table.size();
+
+        std::vector<formatResult> results;
+        for(auto& format: PixelConverter::formats()){
+            formatResult measured;
+            measured.name = format.name;
+            measured.converted = format.convertRow != nullptr;
+            auto start = clock::now();
+            for(int round=0;round<rounds;round++)
+                PixelConverter::convert(format, source, width*format.sourceBytesPerPixel, width, height,
+                                        target.data(), width*format.targetBytesPerPixel(), state);
+            const double ms = std::chrono::duration<double, std::milli>(clock::now() - start).count();
+            measured.msPerFrame = ms/std::max(1, rounds);
+            measured.megapixelsPerSecond = ms > 0 ? double(width)*height*rounds/(ms*1000.) : 0.;
+            results.push_back(measured);
+        }
+        return results;
+    }
+};
+
+#endif // DECODE_BENCHMARK_H
@@ -0,0 +1,190 @@
+#ifndef DEPTH_CODEC_H
+#define DEPTH_CODEC_H
+
+#include <cstdint>
+#include <cstring>
+#include <vector>
+
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+
+//lossless codec for 16-bit depth kept in RAM: LOCO-I (MED) prediction + Rice codes with a k per block of 16 residuals.
+//depth is smooth and mostly valid-or-zero in patches, so residuals are tiny and k sits at 0-2 most of the time
+class DepthCodec {
+    static constexpr int blockSize = 16;
+    static constexpr int kBits = 5;
+    static constexpr uint32_t escapeQuotient = 24;
+    static constexpr int escapeBits = 17;//zigzagged difference of two 16-bit values
+
+    static inline int countLeadingZeros(uint64_t value){
+#ifdef _MSC_VER
+        unsigned long index;
+        _BitScanReverse64(&index, value);
+        return 63 - int(index);
+#else
+        return __builtin_clzll(value);
+#endif
+    }
+    static inline int predict(int left, int up, int upLeft){
+        int low = left < up ? left : up;
+        int high = left < up ? up : left;
+        if(upLeft >= high)
+            return low;
+        if(upLeft <= low)
+            return high;
+        return left + up - upLeft;
+    }
+    static inline uint32_t zigzag(int value){
+        return value >= 0 ? uint32_t(value) << 1 : (uint32_t(-value) << 1) - 1;
+    }
+    static inline int unzigzag(uint32_t value){
+        return (value & 1) ? -int((value + 1) >> 1) : int(value >> 1);
+    }
+
+    struct bitWriter{
+        std::vector<uint8_t>& out;
+        uint64_t acc = 0;
+        int count = 0;
+        void put(uint32_t bits, int n){
+            acc = (acc << n) | (bits & ((uint64_t(1) << n) - 1));
+            count += n;
+            while(count >= 8){
+                count -= 8;
+                out.push_back(uint8_t(acc >> count));
+            }
+        }
+        void flush(){
+            if(count)
+                out.push_back(uint8_t(acc << (8 - count)));
+            count = 0;
+        }
+    };
+    //bits are kept left-aligned in acc, reading past the end yields zeros
+    struct bitReader{
+        const uint8_t* pos;
+        const uint8_t* end;
+        uint64_t availableBits;
+        uint64_t consumedBits = 0;
+        uint64_t acc = 0;
+        int count = 0;
+        bitReader(const uint8_t* begin, const uint8_t* end): pos(begin), end(end), availableBits(uint64_t(end - begin)*8) {}
+        bool overrun() const{
+            return consumedBits > availableBits;
+        }
+        inline void refill(){
+            while(count <= 56){
+                uint64_t byte = pos < end ? *pos++ : 0;
+                acc |= byte << (56 - count);
+                count += 8;
+            }
+        }
+        inline uint32_t get(int n){
+            refill();
+            uint32_t value = uint32_t(acc >> (64 - n));
+            acc <<= n;
+            count -= n;
+            consumedBits += n;
+            return value;
+        }
+        //zeros terminated by a one, the quotient is never longer than escapeQuotient
+        inline uint32_t unary(){
+            refill();
+            if(!acc){
+                consumedBits = availableBits + 1;
+                return escapeQuotient;
+            }
+            int zeros = countLeadingZeros(acc);
+            acc <<= zeros + 1;
+            count -= zeros + 1;
+            consumedBits += zeros + 1;
+            return uint32_t(zeros);
+        }
+    };
+
+    static void encodeBlock(bitWriter& writer, const uint32_t* residuals, int count){
+        uint64_t sum = 0;
+        for(int i=0;i<count;i++)
+            sum += residuals[i];
+        int k = 0;
+        while(k < 16 && (uint64_t(count) << (k + 1)) <= sum)
+            k++;
+        writer.put(uint32_t(k), kBits);
+        for(int i=0;i<count;i++){
+            uint32_t quotient = residuals[i] >> k;
+            if(quotient >= escapeQuotient){
+                writer.put(1, int(escapeQuotient) + 1);
+                writer.put(residuals[i], escapeBits);
+                continue;
+            }
+            writer.put(1, int(quotient) + 1);
+            if(k)
+                writer.put(residuals[i], k);
+        }
+    }
+public:
+    //stride is in bytes
+    static std::vector<uint8_t> encode(const uint16_t* pixels, int width, int height, int stride){
+        std::vector<uint8_t> out;
+        out.reserve(size_t(width)*height/2);
+        uint32_t header[2] = {uint32_t(width), uint32_t(height)};
+        out.resize(sizeof(header));
+        std::memcpy(out.data(), header, sizeof(header));
+
+        bitWriter writer{out};
+        std::vector<uint32_t> residuals(width);
+        const uint16_t* previousRow = nullptr;
+        for(int y=0;y<height;y++){
+            auto row = reinterpret_cast<const uint16_t*>(reinterpret_cast<const uint8_t*>(pixels) + size_t(y)*stride);
+            for(int x=0;x<width;x++){
+                int left = x ? row[x-1] : (previousRow ? previousRow[x] : 0);
+                int up = previousRow ? previousRow[x] : left;
+                int upLeft = previousRow && x ? previousRow[x-1] : up;
+                residuals[x] = zigzag(int(row[x]) - predict(left, up, upLeft));
+            }
+            for(int x=0;x<width;x+=blockSize)
+                encodeBlock(writer, residuals.data() + x, width - x < blockSize ? width - x : blockSize);
+            previousRow = row;
+        }
+        writer.flush();
+        out.shrink_to_fit();
+        return out;
+    }
+    //pixels gets width*height values with no padding; false if the data is damaged or has other dimensions
+    static bool decode(const uint8_t* data, size_t size, uint16_t* pixels, int width, int height){
+        uint32_t header[2];
+        if(size < sizeof(header))
+            return false;
+        std::memcpy(header, data, sizeof(header));
+        if(header[0] != uint32_t(width) || header[1] != uint32_t(height))
+            return false;
+
+        bitReader reader(data + sizeof(header), data + size);
+        uint32_t residuals[blockSize];
+        for(int y=0;y<height;y++){
+            uint16_t* row = pixels + size_t(y)*width;
+            const uint16_t* previousRow = y ? row - width : nullptr;
+            for(int x=0;x<width;x+=blockSize){
+                const int count = width - x < blockSize ? width - x : blockSize;
+                const int k = int(reader.get(kBits));
+                for(int i=0;i<count;i++){
+                    uint32_t quotient = reader.unary();
+                    if(quotient >= escapeQuotient)
+                        residuals[i] = reader.get(escapeBits);
+                    else
+                        residuals[i] = k ? (quotient << k) | reader.get(k) : quotient;
+                }
+                for(int i=0;i<count;i++){
+                    const int px = x + i;
+                    int left = px ? row[px-1] : (previousRow ? previousRow[px] : 0);
+                    int up = previousRow ? previousRow[px] : left;
+                    int upLeft = previousRow && px ? previousRow[px-1] : up;
+                    row[px] = uint16_t(predict(left, up, upLeft) + unzigzag(residuals[i]));
+                }
+            }
+        }
+        return !reader.overrun();
+    }
+};
+
+#endif // DEPTH_CODEC_H
@@ -0,0 +1,243 @@
+#ifndef DEPTH_COLORMAP_H
+#define DEPTH_COLORMAP_H
+
+#include <atomic>
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <vector>
+
+#if defined(__AVX2__)
+#include <immintrin.h>
+#define DEPTH_COLORMAP_AVX2
+#endif
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define DEPTH_COLORMAP_SSE2
+#endif
+
+//depth in mm to 0xffRRGGBB through a 256 entry table: entry 0 is the invalid (zero depth) color,
+//1..255 the palette from near to far. the index math runs 8/16 pixels at a time, depths outside
+//near..far are clamped to the palette's ends. with an equalization table the index comes from the depth's
+//histogram bin instead of the linear near..far mapping
+class DepthColormap {
+public:
+    enum class Palette{
+        TURBO,
+        JET,
+        GRAYSCALE
+    };
+    //optional histogram filled in the same pass: 16 mm bins, interleaved in lanes so that
+    //neighbouring pixels of the same depth don't wait on each other's increment
+    static constexpr int histogramShift = 4;
+    static constexpr int histogramBins = 65536 >> histogramShift;
+    static constexpr int histogramLanes = 4;
+private:
+    static constexpr int paletteSize = 255;
+
+    uint32_t lut[256];
+    Palette palette;
+    uint16_t nearMm;
+    uint16_t farMm;
+    uint32_t invalid;
+    //v = min(depth - near, range) << shift lands in [32768, 65535] at most, index = mulhi(v, scale) + 1
+    uint16_t range;
+    int shift;
+    uint16_t scale;
+    std::vector<uint8_t> equalization;//bin -> table index, empty when off
+    std::atomic<uint64_t> mappedBytes{0};
+    std::atomic<uint64_t> mappedNanoseconds{0};
+
+    static uint8_t toByte(double value){
+        return uint8_t(std::lround(std::min(1., std::max(0., value))*255));
+    }
+    //google's polynomial fit of turbo
+    static void turbo(double t, double& r, double& g, double& b){
+        r = 0.13572138 + t*(4.61539260 + t*(-42.66032258 + t*(132.13108234 + t*(-152.94239396 + t*59.28637943))));
+        g = 0.09140261 + t*(2.19418839 + t*(4.84296658 + t*(-14.18503333 + t*(4.27729857 + t*2.82956604))));
+        b = 0.10667330 + t*(12.64194608 + t*(-60.58204836 + t*(110.36276771 + t*(-89.90310912 + t*27.34824973))));
+    }
+    static void jet(double t, double& r, double& g, double& b){
+        r = 1.5 - std::abs(4*t - 3);
+        g = 1.5 - std::abs(4*t - 2);
+        b = 1.5 - std::abs(4*t - 1);
+    }
+    void rebuild(){
+        lut[0] = invalid;
+        for(int i=0;i<paletteSize;i++){
+            double t = double(i)/(paletteSize - 1), r, g, b;
+            switch(palette){
+            case Palette::TURBO: turbo(t, r, g, b); break;
+            case Palette::JET: jet(t, r, g, b); break;
+            default: r = g = b = t; break;
+            }
+            lut[i + 1] = 0xff000000u | (uint32_t(toByte(r)) << 16) | (uint32_t(toByte(g)) << 8) | toByte(b);
+        }
+        range = uint16_t(std::max(1, int(farMm) - int(nearMm)));
+        shift = 0;
+        while((uint32_t(range) << (shift + 1)) <= 0xffff)
+            shift++;
+        scale = uint16_t((uint32_t(paletteSize - 1) << 16)/(uint32_t(range) << shift));
+    }
+    inline uint32_t mapOne(uint16_t depth) const{
+        if(!depth)
+            return lut[0];
+        uint32_t v = depth > nearMm ? depth - nearMm : 0;
+        v = std::min<uint32_t>(v, range) << shift;
+        return lut[((v*scale) >> 16) + 1];
+    }
+public:
+    DepthColormap(): palette(Palette::TURBO), nearMm(300), farMm(8000), invalid(0xff000000u) {
+        rebuild();
+    }
+    void setPalette(Palette newPalette){
+        palette = newPalette;
+        rebuild();
+    }
+    Palette getPalette() const{
+        return palette;
+    }
+    void setRange(uint16_t nearDepth, uint16_t farDepth){
+        nearMm = std::min(nearDepth, farDepth);
+        farMm = std::max(nearDepth, farDepth);
+        rebuild();
+    }
+    uint16_t nearDepth() const{
+        return nearMm;
+    }
+    uint16_t farDepth() const{
+        return farMm;
+    }
+    //0xAARRGGBB
+    void setInvalidColor(uint32_t color){
+        invalid = color;
+        rebuild();
+    }
+    uint32_t invalidColor() const{
+        return invalid;
+    }
+    //bin 0 (below 16 mm) is taken as invalid
+    void setEqualization(std::vector<uint8_t> binToIndex){
+        if(binToIndex.size() != size_t(histogramBins))
+            return;
+        binToIndex[0] = 0;
+        equalization = std::move(binToIndex);
+    }
+    void clearEqualization(){
+        equalization.clear();
+    }
+    bool isEqualized() const{
+        return !equalization.empty();
+    }
+    //one row (or any run) of pixels, histogram has histogramLanes*histogramBins counters
+    void apply(const uint16_t* depth, uint32_t* out, int count, uint32_t* histogram = nullptr) const{
+        if(!equalization.empty()){
+            applyEqualized(depth, out, count, histogram);
+            return;
+        }
+        int i = 0;
+#if defined(DEPTH_COLORMAP_AVX2)
+        const __m256i nearV = _mm256_set1_epi16(short(nearMm));
+        const __m256i rangeV = _mm256_set1_epi16(short(range));
+        const __m256i scaleV = _mm256_set1_epi16(short(scale));
+        const __m256i one = _mm256_set1_epi16(1);
+        const __m256i zero = _mm256_setzero_si256();
+        const __m128i shiftV = _mm_cvtsi32_si128(shift);
+        alignas(32) uint16_t bins[16];
+        for(;i+16<=count;i+=16){
+            __m256i d = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(depth + i));
+            if(histogram){
+                _mm256_store_si256(reinterpret_cast<__m256i*>(bins), _mm256_srli_epi16(d, histogramShift));
+                for(int j=0;j<16;j++)
+                    histogram[(j % histogramLanes)*histogramBins + bins[j]]++;
+            }
+            __m256i v = _mm256_min_epu16(_mm256_subs_epu16(d, nearV), rangeV);
+            __m256i index = _mm256_add_epi16(_mm256_mulhi_epu16(_mm256_sll_epi16(v, shiftV), scaleV), one);
+            index = _mm256_andnot_si256(_mm256_cmpeq_epi16(d, zero), index);
+            __m256i low = _mm256_cvtepu16_epi32(_mm256_castsi256_si128(index));
+            __m256i high = _mm256_cvtepu16_epi32(_mm256_extracti128_si256(index, 1));
+            _mm256_storeu_si256(reinterpret_cast<__m256i*>(out + i), _mm256_i32gather_epi32(reinterpret_cast<const int*>(lut), low, 4));
+            _mm256_storeu_si256(reinterpret_cast<__m256i*>(out + i + 8), _mm256_i32gather_epi32(reinterpret_cast<const int*>(lut), high, 4));
+        }
+#elif defined(DEPTH_COLORMAP_SSE2)
+        //no gather before AVX2: the indices are computed in registers and looked up from L1
+        const __m128i nearV = _mm_set1_epi16(short(nearMm));
+        const __m128i rangeV = _mm_set1_epi16(short(range));
+        const __m128i scaleV = _mm_set1_epi16(short(scale));
+        const __m128i one = _mm_set1_epi16(1);
+        const __m128i zero = _mm_setzero_si128();
+        const __m128i shiftV = _mm_cvtsi32_si128(shift);
+        alignas(16) uint8_t indices[16];
+        alignas(16) uint16_t bins[16];
+        for(;i+16<=count;i+=16){
+            __m128i packed[2];
+            for(int half=0;half<2;half++){
+                __m128i d = _mm_loadu_si128(reinterpret_cast<const __m128i*>(depth + i + half*8));
+                _mm_store_si128(reinterpret_cast<__m128i*>(bins + half*8), _mm_srli_epi16(d, histogramShift));
+                __m128i v = _mm_subs_epu16(d, nearV);
+                v = _mm_sub_epi16(v, _mm_subs_epu16(v, rangeV));//min for unsigned, SSE2 only has the signed one
+                __m128i index = _mm_add_epi16(_mm_mulhi_epu16(_mm_sll_epi16(v, shiftV), scaleV), one);
+                packed[half] = _mm_andnot_si128(_mm_cmpeq_epi16(d, zero), index);
+            }
+            _mm_store_si128(reinterpret_cast<__m128i*>(indices), _mm_packus_epi16(packed[0], packed[1]));
+            for(int j=0;j<16;j++)
+                out[i + j] = lut[indices[j]];
+            if(histogram)
+                for(int j=0;j<16;j++)
+                    histogram[(j % histogramLanes)*histogramBins + bins[j]]++;
+        }
+#endif
+        for(;i<count;i++){
+            out[i] = mapOne(depth[i]);
+            if(histogram)
+                histogram[(i % histogramLanes)*histogramBins + (depth[i] >> histogramShift)]++;
+        }
+    }
+private:
+    void applyEqualized(const uint16_t* depth, uint32_t* out, int count, uint32_t* histogram) const{
+        int i = 0;
+#if defined(DEPTH_COLORMAP_SSE2)
+        alignas(16) uint16_t bins[8];
+        for(;i+8<=count;i+=8){
+            _mm_store_si128(reinterpret_cast<__m128i*>(bins), _mm_srli_epi16(_mm_loadu_si128(reinterpret_cast<const __m128i*>(depth + i)), histogramShift));
+            for(int j=0;j<8;j++)
+                out[i + j] = lut[equalization[bins[j]]];
+            if(histogram)
+                for(int j=0;j<8;j++)
+                    histogram[(j % histogramLanes)*histogramBins + bins[j]]++;
+        }
+#endif
+        for(;i<count;i++){
+            int bin = depth[i] >> histogramShift;
+            out[i] = lut[equalization[bin]];
+            if(histogram)
+                histogram[(i % histogramLanes)*histogramBins + bin]++;
+        }
+    }
+public:
+    //throughput bookkeeping, in depth bytes read
+    void recordRun(uint64_t bytes, uint64_t nanoseconds){
+        mappedBytes += bytes;
+        mappedNanoseconds += nanoseconds;
+    }
+    double gigabytesPerSecond() const{
+        uint64_t ns = mappedNanoseconds;
+        return ns ? double(mappedBytes)/ns : 0.;
+    }
+    void resetStats(){
+        mappedBytes = 0;
+        mappedNanoseconds = 0;
+    }
+    static const char* kernelName(){
+#if defined(DEPTH_COLORMAP_AVX2)
+        return "AVX2";
+#elif defined(DEPTH_COLORMAP_SSE2)
+        return "SSE2";
+#else
+        return "scalar";
+#endif
+    }
+};
+
+#endif // DEPTH_COLORMAP_H
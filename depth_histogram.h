@@ -0,0 +1,113 @@
+#ifndef DEPTH_HISTOGRAM_H
+#define DEPTH_HISTOGRAM_H
+
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <vector>
+
+#include "depth_colormap.h"
+
+//depth histograms of the last few shown frames. the colormap pass fills the scratch lanes, commitFrame()
+//folds them into a rolling sum, and range and equalization are taken from that sum, not from a single frame,
+//so the colors don't flicker with every bit of sensor noise. bin 0 (no depth) is left out everywhere
+class DepthHistogram {
+public:
+    static constexpr int bins = DepthColormap::histogramBins;
+    static constexpr int lanes = DepthColormap::histogramLanes;
+    static constexpr size_t defaultWindow = 15;
+private:
+    size_t window;
+    std::vector<uint32_t> scratch;
+    std::vector<uint32_t> recent;//ring of window histograms, allocated once
+    size_t nextSlot;//the oldest one once the ring is full
+    size_t filledSlots;
+    std::vector<uint64_t> rolling;
+    uint64_t rollingTotal;
+    uint64_t bookkeepingNanoseconds;
+    uint64_t frames;
+public:
+    explicit DepthHistogram(size_t window = defaultWindow):
+        window(std::max<size_t>(1, window)), scratch(size_t(lanes)*bins),
+        recent(this->window*bins), nextSlot(0), filledSlots(0), rolling(bins), rollingTotal(0),
+        bookkeepingNanoseconds(0), frames(0)
+    {}
+    //cleared counters for the colormap pass of one frame
+    uint32_t* frameScratch(){
+        std::fill(scratch.begin(), scratch.end(), 0);
+        return scratch.data();
+    }
+    void commitFrame(){
+        auto start = std::chrono::steady_clock::now();
+        //the new frame takes the oldest one's slot, which leaves the sum first
+        uint32_t* frame = recent.data() + nextSlot*bins;
+        if(filledSlots == window){
+            for(int bin=1;bin<bins;bin++){
+                rolling[bin] -= frame[bin];
+                rollingTotal -= frame[bin];
+            }
+        }
+        else
+            filledSlots++;
+        std::fill(frame, frame + bins, 0);
+        for(int lane=0;lane<lanes;lane++)
+            for(int bin=1;bin<bins;bin++)
+                frame[bin] += scratch[size_t(lane)*bins + bin];
+        for(int bin=1;bin<bins;bin++){
+            rolling[bin] += frame[bin];
+            rollingTotal += frame[bin];
+        }
+        nextSlot = (nextSlot + 1) % window;
+        bookkeepingNanoseconds += std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start).count();
+        frames++;
+    }
+    //depths between the low and high quantiles of the recent frames, false while there's no valid depth at all
+    bool quantileRange(double low, double high, uint16_t& nearMm, uint16_t& farMm) const{
+        if(!rollingTotal)
+            return false;
+        const uint64_t lowCount = uint64_t(low*rollingTotal);
+        const uint64_t highCount = uint64_t(high*rollingTotal);
+        uint64_t cumulative = 0;
+        int lowBin = -1, highBin = bins - 1;
+        for(int bin=1;bin<bins;bin++){
+            cumulative += rolling[bin];
+            if(lowBin < 0 && cumulative > lowCount)
+                lowBin = bin;
+            if(cumulative >= highCount){
+                highBin = bin;
+                break;
+            }
+        }
+        if(lowBin < 0)
+            lowBin = highBin;
+        nearMm = uint16_t(lowBin << DepthColormap::histogramShift);
+        farMm = uint16_t(std::min(65535, (highBin + 1) << DepthColormap::histogramShift));
+        return true;
+    }
+    //bin -> palette index 1..255 following the cumulative distribution
+    std::vector<uint8_t> equalizationTable() const{
+        std::vector<uint8_t> table(bins);
+        if(!rollingTotal)
+            return table;
+        uint64_t cumulative = 0;
+        for(int bin=1;bin<bins;bin++){
+            cumulative += rolling[bin];
+            table[bin] = uint8_t(1 + (cumulative*254)/rollingTotal);
+        }
+        return table;
+    }
+    void reset(){
+        nextSlot = 0;
+        filledSlots = 0;
+        std::fill(rolling.begin(), rolling.end(), 0);
+        rollingTotal = 0;
+        bookkeepingNanoseconds = 0;
+        frames = 0;
+    }
+    //the merge and the rolling sum; counting itself is part of the colormap pass
+    double averageBookkeepingMs() const{
+        return frames ? bookkeepingNanoseconds/1e6/frames : 0.;
+    }
+};
+
+#endif // DEPTH_HISTOGRAM_H
@@ -3,15 +3,166 @@
 
 #include <QMutex>
 #include <QWidget>
-#include <QGraphicsItem>
-#include <QGraphicsPixmapItem>
+#include <QImage>
 
+#include <algorithm>
 #include <vector>
 #include <iostream>
 #include <string>
 #include <thread>
+#include <memory>
+#include <deque>
+#include <future>
+#include <cstring>
+#include <atomic>
+#include <chrono>
 
 #include "Include/OpenNI.h"
+#include "Include/PS1080.h"
+
+#include "frame_cache.h"
+#include "conversion_pool.h"
+#include "oni_file_reader.h"
+#include "frame_arena.h"
+#include "depth_codec.h"
+#include "depth_colormap.h"
+#include "depth_histogram.h"
+#include "frame_scaler.h"
+#include "stream_sync.h"
+#include "overlay_blend.h"
+#include "frame_diff.h"
+#include "ps_depth_decoder.h"
+#include "jpeg_decoder.h"
+#include "pixel_converter.h"
+#include "ir_gain.h"
+
+//one frame as read from the recording: OpenNI's own buffer, a view into the mapped file or a copied payload.
+//natively read depth may still be 16z/16zT compressed and color JPEG, they're expanded by whichever thread converts them
+struct rawVideoFrame{
+    openni::VideoFrameRef ref;
+    const uchar* view = nullptr;
+    std::shared_ptr<const uchar> viewOwner;//keeps the mapping alive as long as the view
+    std::vector<uint8_t> payload;
+    int width = 0;
+    int height = 0;
+    int stride = 0;
+    uint32_t codec = OniFileReader::CODEC_UNCOMPRESSED;
+    size_t compressedSize = 0;
+    int pixelFormat = 0;//OniPixelFormat, 0 is taken for what the view takes
+    bool isCompressed() const{
+        return codec == OniFileReader::CODEC_16Z || codec == OniFileReader::CODEC_16Z_EMB_TABLES || codec == OniFileReader::CODEC_JPEG;
+    }
+    //into tight rows of width values
+    bool expandDepth(uint16_t* target) const{
+        const size_t pixels = size_t(width)*height;
+        if(codec == OniFileReader::CODEC_16Z)
+            return PsDepthDecoder::decode16z(data(), compressedSize, target, pixels);
+        if(codec == OniFileReader::CODEC_16Z_EMB_TABLES)
+            return PsDepthDecoder::decode16zWithTable(data(), compressedSize, target, pixels);
+        return false;
+    }
+    //RGB888 at JpegDecoder::reducedSize() of width and height
+    bool expandColor(uchar* target, int targetStride, int reduction) const{
+        return codec == OniFileReader::CODEC_JPEG &&
+               JpegDecoder::decode(data(), compressedSize, width, height, target, targetStride, reduction);
+    }
+    const uchar* data() const{
+        if(view)
+            return view;
+        return ref.isValid() ? (const uchar*)ref.getData() : payload.data();
+    }
+};
+
+//how well depth compresses for the opened file, shared by every frame stored compressed
+struct depthCompressionStats{
+    std::atomic<uint64_t> rawBytes{0};
+    std::atomic<uint64_t> storedBytes{0};
+    std::atomic<uint64_t> encodeNanoseconds{0};
+    std::atomic<uint64_t> decodeNanoseconds{0};
+    std::atomic<uint64_t> framesEncoded{0};
+    std::atomic<uint64_t> framesDecoded{0};
+    double ratio() const{
+        return storedBytes ? double(rawBytes)/storedBytes : 0.;
+    }
+    double averageDecodeMs() const{
+        return framesDecoded ? decodeNanoseconds/1e6/framesDecoded : 0.;
+    }
+    double averageEncodeMs() const{
+        return framesEncoded ? encodeNanoseconds/1e6/framesEncoded : 0.;
+    }
+};
+
+//display-ready pixels of one stream, either in an arena slot, borrowed from the mapped file
+//or, for depth, kept compressed and only expanded when it's shown
+struct frameBuffer{
+    std::shared_ptr<uchar> data;
+    std::shared_ptr<const std::vector<uint8_t>> compressed;
+    std::shared_ptr<depthCompressionStats> stats;
+    int width = 0;
+    int height = 0;
+    int stride = 0;
+    QImage::Format format = QImage::Format_Invalid;
+    bool ownsMemory = false;
+    bool isValid() const{
+        return data != nullptr || compressed != nullptr;
+    }
+    //mapped frames live in the page cache, they don't count against the budget
+    size_t bytes() const{
+        if(compressed)
+            return compressed->size();
+        return ownsMemory ? size_t(stride)*height : 0;
+    }
+    //doesn't copy, the buffer has to outlive the image; compressed frames are decoded into an image of their own
+    QImage image() const{
+        if(!compressed)
+            return QImage(data.get(), width, height, stride, format);
+        auto start = std::chrono::steady_clock::now();
+        QImage decoded(width, height, QImage::Format_Grayscale16);
+        //scanlines are padded to 4 bytes, odd widths need a tight buffer in between
+        const bool tight = decoded.bytesPerLine() == width*2;
+        std::vector<uint16_t> pixels(tight ? 0 : size_t(width)*height);
+        auto target = tight ? reinterpret_cast<uint16_t*>(decoded.bits()) : pixels.data();
+        if(!DepthCodec::decode(compressed->data(), compressed->size(), target, width, height))
+            return QImage();
+        for(int row=0;!tight && row<height;row++)
+            std::memcpy(decoded.scanLine(row), pixels.data() + size_t(row)*width, size_t(width)*2);
+        if(stats){
+            stats->decodeNanoseconds += std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start).count();
+            stats->framesDecoded++;
+        }
+        return decoded;
+    }
+    //a plain buffer of the decoded depth, so that several views of one frame share a single decode
+    frameBuffer decompressed() const{
+        if(!compressed)
+            return *this;
+        auto decoded = std::make_shared<QImage>(image());
+        if(decoded->isNull())
+            return {};
+        frameBuffer buffer;
+        buffer.data = std::shared_ptr<uchar>(decoded, decoded->bits());
+        buffer.width = width;
+        buffer.height = height;
+        buffer.stride = int(decoded->bytesPerLine());
+        buffer.format = decoded->format();
+        buffer.ownsMemory = true;
+        return buffer;
+    }
+};
+
+//every view of one moment of the recording, they are decoded and evicted together.
+//a stream the recording doesn't have stays empty, IR also where its stream has no frame
+struct decodedFrame{
+    frameBuffer color;
+    frameBuffer depth;
+    frameBuffer ir;
+    bool isValid() const{
+        return color.isValid() || depth.isValid();
+    }
+    size_t bytes() const{
+        return color.bytes() + depth.bytes() + ir.bytes();
+    }
+};
 
 //if there could be more time, i'd prefer a different approach
 struct deviceVStreamInfo{
@@ -25,75 +176,540 @@ struct deviceVStreamInfo{
     openni::PlaybackControl *playbackControl;
     openni::VideoStream *depthStream;
     openni::VideoStream *colorStream;
-    std::vector<QGraphicsPixmapItem*> depthPixmaps;
-    std::vector<QGraphicsPixmapItem*> colorPixmaps;
+    openni::VideoStream *irStream;
+    OniFileReader oniReader;
+    const OniFileReader::streamInfo* nativeDepth;
+    const OniFileReader::streamInfo* nativeColor;
+    const OniFileReader::streamInfo* nativeIr;
+
+    //keeps the old vector-like indexing, but frames come from the cache and are decoded again once evicted
+    struct frameTrack{
+        deviceVStreamInfo* owner;
+        bool isDepth;
+        frameBuffer operator[](size_t index) const{
+            auto frame = owner->frameAt(index);
+            return isDepth ? frame.depth : frame.color;
+        }
+        size_t size() const{
+            return owner->framesCount;
+        }
+    };
+    static constexpr size_t defaultCacheBudget = size_t(1024)<<20;
+    static constexpr int oniFirstFrameIndex = 1;//OniFile numbers frames from 1
+    static constexpr int maxDivisor = 16;//a view smaller than that is collapsed, not worth a coarser frame
+
+    frameTrack depthFrames;
+    frameTrack colorFrames;
+    FrameArena depthArena;
+    FrameArena colorArena;
+    FrameArena irArena;
+    FrameArena depthDisplayArena;
+    FrameArena irDisplayArena;
+    FrameArena overlayArena;
+    FrameArena colorDifferenceArena;
+    FrameArena depthDifferenceArena;
+    DepthColormap depthColormap;
+    DepthHistogram depthHistogram;
+    DepthColormap differenceColormap;
+    LruCache<int64_t, decodedFrame> frameCache;
+    ConversionPool conversionPool;
+    std::shared_ptr<depthCompressionStats> compressionStats;
+    std::vector<uint16_t> shiftToDepth;//for SHIFT_9_2/9_3 depth, empty otherwise
+    StreamSync sync;//display ticks to the frames of each stream
+    size_t framesCount;//ticks
     int64_t FPS;
     int64_t lastReadyFrame;
+    int64_t streamPosition;//index of the frame the next readFrame will return
     bool readyForUsage;
+    bool useMemoryMapping;
+    bool compressDepth;
+    bool autoDepthRange;
+    bool equalizeDepth;
+    bool overlayDepth;
+    uint32_t overlayAlpha;//0..256
+    bool showDifference;
+    int differenceStride;//frames back to compare with
+    int colorDifferenceGain;//as a shift
+    bool decodeIr;
+    float irLow, irHigh;//auto gain range, follows the frames shown
+    //frames are converted at 1/divisor of the recorded size, see setDisplayDivisors
+    std::atomic<int> colorDivisor;
+    std::atomic<int> depthDivisor;
+    std::atomic<int> irDivisor;
     QMutex fileProcessing;
     QMutex firstFrameReady;
+    QMutex streamAccess;
     deviceVStreamInfo():
         device(nullptr), playbackControl(nullptr),
         depthStream(new openni::VideoStream),
         colorStream(new openni::VideoStream),
-        FPS(0), lastReadyFrame(-1), readyForUsage(false)
-    {}
+        irStream(new openni::VideoStream),
+        nativeDepth(nullptr), nativeColor(nullptr), nativeIr(nullptr),
+        depthFrames({this, true}), colorFrames({this, false}),
+        frameCache(defaultCacheBudget), compressionStats(std::make_shared<depthCompressionStats>()), framesCount(0),
+        FPS(0), lastReadyFrame(-1), streamPosition(0), readyForUsage(false), useMemoryMapping(true), compressDepth(false),
+        autoDepthRange(false), equalizeDepth(false), overlayDepth(false), overlayAlpha(128), showDifference(false), differenceStride(1), colorDifferenceGain(2),
+        decodeIr(true), irLow(0), irHigh(0), colorDivisor(1), depthDivisor(1), irDivisor(1)
+    {
+        setDifferenceRange(100);
+        differenceColormap.setPalette(DepthColormap::Palette::JET);
+    }
     ~deviceVStreamInfo(){
         clearAll(true);
     }
+    //the first stream of that type, nullptr when the recording has none or it has no frames
+    static const OniFileReader::streamInfo* recordedStream(const OniFileReader& reader, int32_t nodeType){
+        auto stream = reader.findStream(nodeType);
+        return stream && !stream->frames.empty() ? stream : nullptr;
+    }
+    //IR is shown like color, except that GRAY16 is kept as it is for the auto gain
+    static bool isKnownColor(const OniFileReader::streamInfo& stream){
+        return (stream.codec == OniFileReader::CODEC_UNCOMPRESSED && stream.pixelFormat != ONI_PIXEL_FORMAT_JPEG &&
+                PixelConverter::find(stream.pixelFormat, false)) ||
+               (stream.codec == OniFileReader::CODEC_JPEG &&
+                (stream.pixelFormat == ONI_PIXEL_FORMAT_RGB888 || stream.pixelFormat == ONI_PIXEL_FORMAT_JPEG));
+    }
+    //uncompressed payloads of any format PixelConverter knows, 16z/16zT depth and JPEG color are read here,
+    //anything else still goes through OpenNI. either of depth and color may be missing, not both;
+    //IR is optional, one that can't be read natively is left out
+    static bool isNativelyPlayable(const OniFileReader& reader){
+        auto depth = recordedStream(reader, OniFileReader::NODE_TYPE_DEPTH);
+        auto color = recordedStream(reader, OniFileReader::NODE_TYPE_IMAGE);
+        if(!depth && !color)
+            return false;
+        const bool depthKnown = !depth || ((depth->codec == OniFileReader::CODEC_UNCOMPRESSED || depth->codec == OniFileReader::CODEC_16Z ||
+                                            depth->codec == OniFileReader::CODEC_16Z_EMB_TABLES) &&
+                                           PixelConverter::find(depth->pixelFormat, true));
+        return depthKnown && (!color || isKnownColor(*color));
+    }
+    bool servesNatively() const{
+        return (nativeDepth || nativeColor) && isNativelyPlayable(oniReader);
+    }
+    bool hasIr() const{
+        return servesNatively() ? nativeIr != nullptr : irStream && irStream->isValid();
+    }
+    //recordings may have no color at all
+    bool decodesJpegColor() const{
+        return servesNatively() && nativeColor && nativeColor->codec == OniFileReader::CODEC_JPEG;
+    }
+    //builds the frame index without OpenNI; fine to fail, OpenNI replay is used then
+    bool openNative(const QString& path){
+        if(!OniFileReader::isPlayable(oniReader.open(path)))
+            return false;
+        nativeDepth = recordedStream(oniReader, OniFileReader::NODE_TYPE_DEPTH);
+        nativeColor = recordedStream(oniReader, OniFileReader::NODE_TYPE_IMAGE);
+        nativeIr = recordedStream(oniReader, OniFileReader::NODE_TYPE_IR);
+        if(nativeIr && !isKnownColor(*nativeIr))
+            nativeIr = nullptr;
+        if(useMemoryMapping && servesNatively())
+            oniReader.mapFile();
+        return nativeDepth || nativeColor;
+    }
+    //reads the stream info and decodes the first frame, after which the file is usable;
+    //then keeps warming the cache up with the next frames while they fit into the budget
     RefillingStatus prepareQPixmaps(){
-        if(!device || !playbackControl)
-            return RefillingStatus::NULL_POINTERS;
-        if(!depthStream || !colorStream)
-            return RefillingStatus::NULL_POINTERS;
-        if(!depthStream->isValid() || !colorStream->isValid())
-            return RefillingStatus::NO_VALID_STREAMS;
-        openni::VideoFrameRef depthFrame, colorFrame;
+        if(!servesNatively()){
+            if(!device || !playbackControl)
+                return RefillingStatus::NULL_POINTERS;
+            if(!depthStream || !colorStream || !irStream)
+                return RefillingStatus::NULL_POINTERS;
+            if(!depthStream->isValid() && !colorStream->isValid())
+                return RefillingStatus::NO_VALID_STREAMS;
+        }
         firstFrameReady.lock();
         fileProcessing.lock();
 
-        size_t depthFramesCount = playbackControl->getNumberOfFrames(*depthStream);
-        size_t colorFramesCount = playbackControl->getNumberOfFrames(*colorStream);
-        size_t frames_count = min(depthFramesCount,colorFramesCount);
-        FPS = colorStream->getVideoMode().getFps();
-
-        depthPixmaps.resize(frames_count,nullptr);
-        colorPixmaps.resize(frames_count,nullptr);
-
-        for(size_t curFrameIndex=0;curFrameIndex<frames_count;curFrameIndex++){
-            auto depth_read_status = depthStream->readFrame(&depthFrame);
-            auto color_read_status = colorStream->readFrame(&colorFrame);
-
-            if(depth_read_status != color_read_status && color_read_status != openni::STATUS_OK){
-                depthPixmaps.resize(curFrameIndex);
-                colorPixmaps.resize(curFrameIndex);
-                fileProcessing.unlock();
-                return RefillingStatus::FRAME_READING_FAILURE;
-            }
-            if(!curFrameIndex)
-                firstFrameReady.unlock();
+        //the native index knows the counts right away, OpenNI has to be asked otherwise; missing streams count 0
+        const bool native = servesNatively();
+        auto countFrames = [this, native](const OniFileReader::streamInfo* recorded, openni::VideoStream* stream) -> size_t{
+            if(native)
+                return recorded ? recorded->frames.size() : 0;
+            return stream->isValid() ? std::max(0, playbackControl->getNumberOfFrames(*stream)) : 0;
+        };
+        //the index has the timestamps even when OpenNI replays, as long as it knows the same streams
+        const bool timed = native || ((nativeDepth != nullptr) == depthStream->isValid() && (nativeColor != nullptr) == colorStream->isValid());
+        if(timed){
+            auto timestampsOf = [](const OniFileReader::streamInfo* recorded){
+                std::vector<uint64_t> timestamps;
+                if(recorded){
+                    timestamps.reserve(recorded->frames.size());
+                    for(auto& frame: recorded->frames)
+                        timestamps.push_back(frame.timestamp);
+                }
+                return timestamps;
+            };
+            sync.build({timestampsOf(nativeDepth), timestampsOf(nativeColor), timestampsOf(nativeIr)});
+        }
+        if(!sync.isTimed())
+            sync.buildByIndex(countFrames(nativeDepth, depthStream), countFrames(nativeColor, colorStream), countFrames(nativeIr, irStream));
+        framesCount = sync.ticks();
+        if(nativeColor && nativeColor->fps)
+            FPS = nativeColor->fps;
+        else if(nativeDepth && nativeDepth->fps)
+            FPS = nativeDepth->fps;
+        else
+            FPS = (colorStream->isValid() ? colorStream : depthStream)->getVideoMode().getFps();
+        prepareShiftTable();
 
-            colorPixmaps[curFrameIndex] = (createColorPixMapFromFrame(colorFrame));
-            depthPixmaps[curFrameIndex] = (createDepthPixMapFromFrame(depthFrame));
+        auto firstFrame = frameAt(0);
+        if(!firstFrame.isValid()){
+            framesCount = 0;
+            firstFrameReady.unlock();
+            fileProcessing.unlock();
+            return RefillingStatus::FRAME_READING_FAILURE;
+        }
+        //everything else is reachable through seeking from now on
+        lastReadyFrame = int64_t(framesCount) - 1;
+        readyForUsage = true;
+        firstFrameReady.unlock();
 
-            lastReadyFrame = curFrameIndex;
+        //reading stays sequential here, converting runs on the pool with a bounded number of frames in flight
+        struct convertingFrame{
+            size_t index;
+            std::future<frameBuffer> depth, color, ir;
+            bool hasDepth, hasColor;
+        };
+        std::deque<convertingFrame> converting;
+        size_t frameBytes = firstFrame.bytes();
+        auto finishOldest = [this, &converting](){
+            auto& oldest = converting.front();
+            decodedFrame frame;
+            frame.depth = oldest.depth.get();
+            frame.color = oldest.color.get();
+            if(oldest.ir.valid())
+                frame.ir = oldest.ir.get();
+            //a failed conversion isn't cached, asking for the frame again retries it
+            if(isComplete(frame, oldest.hasDepth, oldest.hasColor))
+                frameCache.put(oldest.index, frame, frame.bytes());
+            converting.pop_front();
+        };
+        for(size_t curFrameIndex=1;curFrameIndex<framesCount;curFrameIndex++){
+            if(!frameCache.hasRoomFor(frameBytes*(converting.size() + 1)))
+                break;
+            if(frameCache.contains(curFrameIndex))
+                continue;
+            rawVideoFrame depthFrame, colorFrame, irFrame;
+            if(!readFrames(curFrameIndex, depthFrame, colorFrame, decodeIr ? &irFrame : nullptr))
+                break;//the rest gets another try when it's actually requested
+            const bool hasDepth = depthFrame.width > 0, hasColor = colorFrame.width > 0;
+            converting.push_back({curFrameIndex,
+                conversionPool.submit([this, depthFrame = std::move(depthFrame)](){ return createDepthBufferFromFrame(depthFrame); }),
+                conversionPool.submit([this, colorFrame = std::move(colorFrame)](){ return createColorBufferFromFrame(colorFrame); }),
+                std::future<frameBuffer>(), hasDepth, hasColor});
+            if(irFrame.width)
+                converting.back().ir = conversionPool.submit([this, irFrame = std::move(irFrame)](){ return createIrBufferFromFrame(irFrame); });
+            if(converting.size() >= 2*conversionPool.threadCount())
+                finishOldest();
         }
-        readyForUsage = frames_count > 0;
+        while(!converting.empty())
+            finishOldest();
         fileProcessing.unlock();
         return RefillingStatus::OK;
     }
+    //shift depth needs the device's shift to depth table: the recorded one when the file has it, computed from
+    //the recorded parameters otherwise (property names as the PS1080 driver records them), its defaults for the rest
+    void prepareShiftTable(){
+        shiftToDepth.clear();
+        const int format = nativeDepth ? nativeDepth->pixelFormat : depthStream->isValid() ? int(depthStream->getVideoMode().getPixelFormat()) : 0;
+        if(format != ONI_PIXEL_FORMAT_SHIFT_9_2 && format != ONI_PIXEL_FORMAT_SHIFT_9_3)
+            return;
+        if(nativeDepth){
+            auto recorded = nativeDepth->generalProperties.find("S2D");
+            if(recorded != nativeDepth->generalProperties.end() && recorded->second.size() >= 2){
+                shiftToDepth.resize(recorded->second.size()/2);
+                std::memcpy(shiftToDepth.data(), recorded->second.data(), shiftToDepth.size()*2);
+                return;
+            }
+        }
+        else{
+            QMutexLocker locker(&streamAccess);
+            std::vector<uint16_t> table(4096);
+            int size = int(table.size()*sizeof(uint16_t));
+            if(depthStream->getProperty(XN_STREAM_PROPERTY_S2D_TABLE, table.data(), &size) == openni::STATUS_OK && size >= 2){
+                table.resize(size_t(size)/sizeof(uint16_t));
+                shiftToDepth = std::move(table);
+                return;
+            }
+        }
+        //zero or missing values keep the format's defaults
+        auto intProperty = [this](const char* name, int id, uint64_t& value){
+            uint64_t found = 0;
+            if(nativeDepth){
+                auto recorded = nativeDepth->intProperties.find(name);
+                found = recorded != nativeDepth->intProperties.end() ? recorded->second : 0;
+            }
+            else{
+                QMutexLocker locker(&streamAccess);
+                if(depthStream->getProperty(id, &found) != openni::STATUS_OK)
+                    found = 0;
+            }
+            if(found)
+                value = found;
+        };
+        auto realProperty = [this](const char* name, int id, double& value){
+            double found = 0;
+            if(nativeDepth){
+                auto recorded = nativeDepth->realProperties.find(name);
+                found = recorded != nativeDepth->realProperties.end() ? recorded->second : 0;
+            }
+            else{
+                QMutexLocker locker(&streamAccess);
+                if(depthStream->getProperty(id, &found) != openni::STATUS_OK)
+                    found = 0;
+            }
+            if(found > 0)
+                value = found;
+        };
+        auto parameters = PixelConverter::defaultShiftParameters(format);
+        intProperty("ZPD", XN_STREAM_PROPERTY_ZERO_PLANE_DISTANCE, parameters.zeroPlaneDistance);
+        realProperty("ZPPS", XN_STREAM_PROPERTY_ZERO_PLANE_PIXEL_SIZE, parameters.zeroPlanePixelSize);
+        realProperty("LDDIS", XN_STREAM_PROPERTY_EMITTER_DCMOS_DISTANCE, parameters.emitterDcmosDistance);
+        intProperty("ConstShift", XN_STREAM_PROPERTY_CONST_SHIFT, parameters.constShift);
+        intProperty("ParamCoeff", XN_STREAM_PROPERTY_PARAM_COEFF, parameters.paramCoeff);
+        intProperty("ShiftScale", XN_STREAM_PROPERTY_SHIFT_SCALE, parameters.shiftScale);
+        intProperty("PixelSizeFactor", XN_STREAM_PROPERTY_PIXEL_SIZE_FACTOR, parameters.pixelSizeFactor);
+        intProperty("MaxShift", XN_STREAM_PROPERTY_MAX_SHIFT, parameters.maxShift);
+        shiftToDepth = PixelConverter::shiftToDepthTable(parameters);
+    }
+    PixelConverter::context conversionContext() const{
+        PixelConverter::context state;
+        state.shiftToDepth = shiftToDepth.data();
+        state.shiftToDepthSize = shiftToDepth.size();
+        return state;
+    }
+    //recorded timestamps (microseconds) give the real rate, the declared FPS is rounded to an int
+    std::chrono::nanoseconds framePeriod() const{
+        auto timed = nativeColor ? nativeColor : nativeDepth;
+        if(timed && timed->frames.size() > 1 && timed->maxTimestamp > timed->minTimestamp)
+            return std::chrono::microseconds(timed->maxTimestamp - timed->minTimestamp)/(timed->frames.size() - 1);
+        return std::chrono::nanoseconds(std::chrono::seconds(1))/(FPS > 0 ? FPS : 30);
+    }
+    //playback and seeking go by recorded time, the nominal rate only stands in without timestamps
+    uint64_t tickTime(int64_t tick) const{
+        return sync.tickTime(size_t(std::max<int64_t>(0, tick)), uint64_t(std::chrono::duration_cast<std::chrono::microseconds>(framePeriod()).count()));
+    }
+    int64_t tickAt(uint64_t microseconds) const{
+        return int64_t(sync.tickAt(microseconds, uint64_t(std::chrono::duration_cast<std::chrono::microseconds>(framePeriod()).count())));
+    }
+    //full size of the recorded frames, empty until the streams are known
+    QSize sourceSize(bool isDepth) const{
+        return sourceSize(isDepth ? nativeDepth : nativeColor, isDepth ? depthStream : colorStream);
+    }
+    QSize irSourceSize() const{
+        return sourceSize(nativeIr, irStream);
+    }
+    QSize sourceSize(const OniFileReader::streamInfo* native, openni::VideoStream* stream) const{
+        if(native && native->width > 0 && native->height > 0)
+            return QSize(native->width, native->height);
+        if(stream && stream->isValid()){
+            auto mode = stream->getVideoMode();
+            return QSize(mode.getResolutionX(), mode.getResolutionY());
+        }
+        return QSize();
+    }
+    //radians, zero when the recording doesn't tell
+    void depthFieldOfView(double& horizontal, double& vertical) const{
+        horizontal = vertical = 0;
+        if(nativeDepth && nativeDepth->horizontalFov > 0 && nativeDepth->verticalFov > 0){
+            horizontal = nativeDepth->horizontalFov;
+            vertical = nativeDepth->verticalFov;
+        }
+        else if(depthStream && depthStream->isValid()){
+            horizontal = depthStream->getHorizontalFieldOfView();
+            vertical = depthStream->getVerticalFieldOfView();
+        }
+    }
+    //the largest whole factor that still leaves the frame at least as big as the view, up to maxDivisor
+    static int divisorFor(const QSize& source, const QSize& view){
+        if(source.isEmpty() || view.isEmpty())
+            return 1;
+        return std::max(1, std::min({source.width()/view.width(), source.height()/view.height(), maxDivisor}));
+    }
+    //every cached frame has the old size, so a change drops them all; frames still being converted
+    //keep the old size, the views fit whatever they get
+    bool setDisplayDivisors(int color, int depth, int ir = 1){
+        color = std::clamp(color, 1, maxDivisor);
+        depth = std::clamp(depth, 1, maxDivisor);
+        ir = std::clamp(ir, 1, maxDivisor);
+        if(color == colorDivisor && depth == depthDivisor && ir == irDivisor)
+            return false;
+        colorDivisor = color;
+        depthDivisor = depth;
+        irDivisor = ir;
+        frameCache.clear();
+        depthArena.reset();//slot sizes follow the first frame converted after this
+        colorArena.reset();
+        irArena.reset();
+        return true;
+    }
+    //frames cached before are missing IR, or have it for nothing
+    void setDecodeIr(bool enabled){
+        if(enabled == decodeIr)
+            return;
+        decodeIr = enabled;
+        frameCache.clear();
+        irArena.reset();
+    }
+    decodedFrame frameAt(size_t index){
+        if(index >= framesCount)
+            return {};
+        if(auto cached = frameCache.get(index))
+            return *cached;
+        bool complete = false;
+        auto frame = decodeFrame(index, complete);
+        if(complete)
+            frameCache.put(index, frame, frame.bytes());
+        return frame;
+    }
+    //every stream that had a frame for the tick converted it; a stream without one is fine, the sync left it out
+    static bool isComplete(const decodedFrame& frame, bool hasDepth, bool hasColor){
+        return frame.isValid() && (!hasDepth || frame.depth.isValid()) && (!hasColor || frame.color.isValid());
+    }
+    //with the file mapped the frame is just a pointer, the payload is copied only if it's misaligned for QImage.
+    //compressed payloads are left compressed, the decoder reads bytes so any alignment does
+    bool readNativeFrame(const OniFileReader::streamInfo& stream, size_t index, rawVideoFrame& frame){
+        frame.width = stream.width;
+        frame.height = stream.height;
+        frame.pixelFormat = stream.pixelFormat;
+        frame.stride = stream.width*PixelConverter::forFormat(stream.pixelFormat, stream.nodeType == OniFileReader::NODE_TYPE_DEPTH).sourceBytesPerPixel;
+        frame.codec = stream.codec;
+        if(index >= stream.frames.size())
+            return false;
+        if(frame.isCompressed()){
+            frame.compressedSize = stream.frames[index].payloadSize;
+            frame.viewOwner = oniReader.payloadView(stream, index);
+            frame.view = frame.viewOwner.get();
+            return frame.view || oniReader.readPayload(stream, index, frame.payload);
+        }
+        const size_t frameSize = size_t(frame.stride)*frame.height;
+        if(stream.frames[index].payloadSize < frameSize)
+            return false;
+        auto view = oniReader.payloadView(stream, index);
+        if(view && reinterpret_cast<uintptr_t>(view.get()) % 4 == 0){
+            frame.viewOwner = std::move(view);
+            frame.view = frame.viewOwner.get();
+            return true;
+        }
+        return oniReader.readPayload(stream, index, frame.payload);
+    }
+    bool readFramePair(size_t index, rawVideoFrame& depthFrame, rawVideoFrame& colorFrame){
+        return readFrames(index, depthFrame, colorFrame, nullptr);
+    }
+    //index is a display tick, each stream reads the frame the sync maps it to. sequential reads skip the seek,
+    //so walking the file in order costs the same as before. streams without a frame for the tick leave theirs
+    //empty (width 0), so does IR that can't be read; OpenNI reads IR even when it's not wanted, its stream
+    //would fall behind the others otherwise
+    bool readFrames(size_t index, rawVideoFrame& depthFrame, rawVideoFrame& colorFrame, rawVideoFrame* irFrame){
+        if(servesNatively()){
+            const size_t depthIndex = sync.frameFor(StreamSync::DEPTH, index);
+            const size_t colorIndex = sync.frameFor(StreamSync::COLOR, index);
+            if((nativeDepth && depthIndex != StreamSync::noFrame && !readNativeFrame(*nativeDepth, depthIndex, depthFrame)) ||
+               (nativeColor && colorIndex != StreamSync::noFrame && !readNativeFrame(*nativeColor, colorIndex, colorFrame)))
+                return false;
+            const size_t irIndex = sync.frameFor(StreamSync::IR, index);
+            if(irFrame && nativeIr && irIndex != StreamSync::noFrame && !readNativeFrame(*nativeIr, irIndex, *irFrame))
+                *irFrame = rawVideoFrame();
+            return true;
+        }
+        //OpenNI seeks the reference stream and lines the others up by itself, but reading on from there
+        //pairs by order again: a frame too far from the tick is left out and the next read seeks afresh
+        QMutexLocker locker(&streamAccess);
+        openni::VideoStream* leading = sync.referenceStream() == StreamSync::COLOR ? colorStream : depthStream;
+        if(!leading->isValid())
+            leading = depthStream->isValid() ? depthStream : colorStream;
+        if(!playbackControl || !leading->isValid() || index >= framesCount)
+            return false;
+        if(int64_t(index) != streamPosition){
+            auto seekStatus = playbackControl->seek(*leading, int(index) + oniFirstFrameIndex);
+            if(seekStatus != openni::STATUS_OK)
+                return false;
+        }
+        rawVideoFrame unwantedIr;
+        rawVideoFrame& ir = irFrame ? *irFrame : unwantedIr;
+        std::pair<openni::VideoStream*, rawVideoFrame*> reads[] = {{depthStream, &depthFrame}, {colorStream, &colorFrame}, {irStream, &ir}};
+        bool aligned = true;
+        for(auto& [stream, frame]: reads){
+            if(!stream->isValid())
+                continue;
+            if(stream->readFrame(&frame->ref) != openni::STATUS_OK){
+                if(stream == irStream)
+                    continue;
+                streamPosition = -1;
+                return false;
+            }
+            if(stream != leading && !sync.withinTolerance(frame->ref.getTimestamp(), index)){
+                *frame = rawVideoFrame();
+                aligned = false;
+                continue;
+            }
+            frame->width = frame->ref.getWidth();
+            frame->height = frame->ref.getHeight();
+            frame->stride = frame->ref.getStrideInBytes();
+            frame->pixelFormat = frame->ref.getVideoMode().getPixelFormat();
+        }
+        streamPosition = aligned ? int64_t(index) + 1 : -1;
+        return true;
+    }
+    //IR OpenNI replays without an indexed IR stream has no timestamps to tell
+    bool hasIrFrame(int64_t index) const{
+        if(!decodeIr || index < 0)
+            return false;
+        if(!sync.framesOf(StreamSync::IR))
+            return hasIr();
+        return sync.frameFor(StreamSync::IR, size_t(index)) != StreamSync::noFrame;
+    }
+    //a frame further from the tick than this is left out, 0 is half the reference stream's frame period.
+    //the mapping changes, so do the frames cached under the ticks
+    void setSyncTolerance(uint64_t microseconds){
+        sync.setTolerance(microseconds);
+        frameCache.clear();
+    }
+    //a single frame: depth and IR go to the pool while color is converted right here
+    decodedFrame decodeFrame(size_t index, bool& complete){
+        rawVideoFrame depthFrame, colorFrame, irFrame;
+        complete = false;
+        if(!readFrames(index, depthFrame, colorFrame, decodeIr ? &irFrame : nullptr))
+            return {};
+        const bool hasDepth = depthFrame.width > 0, hasColor = colorFrame.width > 0;
+        auto depthBuffer = conversionPool.submit([this, depthFrame = std::move(depthFrame)](){ return createDepthBufferFromFrame(depthFrame); });
+        std::future<frameBuffer> irBuffer;
+        if(irFrame.width)
+            irBuffer = conversionPool.submit([this, irFrame = std::move(irFrame)](){ return createIrBufferFromFrame(irFrame); });
+        decodedFrame frame;
+        frame.color = createColorBufferFromFrame(colorFrame);
+        frame.depth = depthBuffer.get();
+        if(irBuffer.valid())
+            frame.ir = irBuffer.get();
+        complete = isComplete(frame, hasDepth, hasColor);
+        return frame;
+    }
     void clearFrameBuffer(){
         lastReadyFrame = -1;
         readyForUsage = false;
-        for(auto& frame: depthPixmaps)
-            delete frame;
-        for(auto& frame: colorPixmaps)
-            delete frame;
-        colorPixmaps.clear();
-        depthPixmaps.clear();
+        framesCount = 0;
+        sync.clear();
+        streamPosition = 0;
+        frameCache.clear();
+        depthArena.reset();
+        colorArena.reset();
+        irArena.reset();
+        depthDisplayArena.reset();
+        irDisplayArena.reset();
+        overlayArena.reset();
+        colorDifferenceArena.reset();
+        depthDifferenceArena.reset();
+        depthHistogram.reset();
+        shiftToDepth.clear();
+        irLow = irHigh = 0;
+        compressionStats = std::make_shared<depthCompressionStats>();
     }
     void clearAll(bool isDestruction=false){
         clearFrameBuffer();
+        QMutexLocker locker(&streamAccess);
+        if(irStream->isValid()){
+            irStream->stop();
+            irStream->destroy();
+        }
         if(colorStream->isValid()){
             colorStream->stop();
             colorStream->destroy();
@@ -107,27 +723,412 @@ struct deviceVStreamInfo{
             device->close();
             delete device;
         }
+        delete irStream;
         delete colorStream;
         delete depthStream;
+        nativeDepth = nullptr;
+        nativeColor = nullptr;
+        nativeIr = nullptr;
+        oniReader.close();
         if(!isDestruction){
             FPS = 0;
             lastReadyFrame = -1;
             depthStream = new openni::VideoStream;
             colorStream = new openni::VideoStream;
+            irStream = new openni::VideoStream;
             readyForUsage = false;
             device = nullptr;
             playbackControl = nullptr;
         }
     }
-    inline QGraphicsPixmapItem* createColorPixMapFromFrame(openni::VideoFrameRef& frame){
-        auto newPixmapItem = new QGraphicsPixmapItem();
-        newPixmapItem->setPixmap(QPixmap::fromImage(QImage((uchar*)frame.getData(),frame.getWidth(),frame.getHeight(),QImage::Format_RGB888)));
-        return newPixmapItem;
+    //depth as it's shown: the cache keeps millimeters, the palette is applied per presented frame,
+    //so changing it doesn't invalidate anything. auto-ranging counts the histogram in the same pass and
+    //adjusts the colors for the frames after this one
+    frameBuffer colorizeDepth(const frameBuffer& depth){
+        return colorizeDepth(depth.image());
+    }
+    frameBuffer colorizeDepth(const QImage& source){
+        if(source.isNull())
+            return {};
+        auto start = std::chrono::steady_clock::now();
+        frameBuffer buffer;
+        buffer.width = source.width();
+        buffer.height = source.height();
+        buffer.stride = buffer.width*4;
+        buffer.format = QImage::Format_RGB32;
+        buffer.ownsMemory = true;
+        buffer.data = depthDisplayArena.acquire(size_t(buffer.stride)*buffer.height);
+        uint32_t* histogram = autoDepthRange || equalizeDepth ? depthHistogram.frameScratch() : nullptr;
+        for(int row=0;row<buffer.height;row++)
+            depthColormap.apply(reinterpret_cast<const uint16_t*>(source.constScanLine(row)),
+                                reinterpret_cast<uint32_t*>(buffer.data.get() + size_t(row)*buffer.stride), buffer.width, histogram);
+        depthColormap.recordRun(uint64_t(buffer.width)*buffer.height*2,
+                                std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start).count());
+        if(histogram){
+            depthHistogram.commitFrame();
+            uint16_t nearMm, farMm;
+            if(autoDepthRange && depthHistogram.quantileRange(0.01, 0.99, nearMm, farMm))
+                depthColormap.setRange(nearMm, farMm);
+            if(equalizeDepth)
+                depthColormap.setEqualization(depthHistogram.equalizationTable());
+        }
+        return buffer;
+    }
+    //colormapped depth blended over the color frame, at the color frame's size. the recording is expected to be
+    //registered (depth to color), a depth frame of another size is stretched over the color one nearest-neighbour
+    frameBuffer overlayDepthOnColor(const frameBuffer& color, const frameBuffer& depth){
+        QImage depthImage = depth.image();//compressed depth is decoded once for both passes
+        auto colorized = colorizeDepth(depthImage);
+        if(!colorized.isValid() || !color.isValid())
+            return colorized;
+        //the blend reads RGB888, any other color format is converted for it first
+        const uchar* colorPixels = color.data.get();
+        int colorStride = color.stride;
+        QImage converted;
+        if(color.format != QImage::Format_RGB888){
+            converted = color.image().convertToFormat(QImage::Format_RGB888);
+            if(converted.isNull())
+                return colorized;
+            colorPixels = converted.constBits();
+            colorStride = int(converted.bytesPerLine());
+        }
+        frameBuffer buffer;
+        buffer.width = color.width;
+        buffer.height = color.height;
+        buffer.stride = color.width*4;
+        buffer.format = QImage::Format_RGB32;
+        buffer.ownsMemory = true;
+        buffer.data = overlayArena.acquire(size_t(buffer.stride)*buffer.height);
+        const bool sameSize = colorized.width == color.width && colorized.height == color.height;
+        std::vector<int> columns(sameSize ? 0 : color.width);
+        for(int x=0;x<int(columns.size());x++)
+            columns[x] = int(int64_t(x)*colorized.width/color.width);
+        std::vector<uint32_t> overlayRow(columns.size());
+        std::vector<uint16_t> depthRow(columns.size());
+        const uint16_t nearMm = depthColormap.nearDepth(), farMm = depthColormap.farDepth();
+        for(int row=0;row<buffer.height;row++){
+            const int sourceRow = sameSize ? row : int(int64_t(row)*colorized.height/color.height);
+            auto overlay = reinterpret_cast<const uint32_t*>(colorized.data.get() + size_t(sourceRow)*colorized.stride);
+            auto depthPixels = reinterpret_cast<const uint16_t*>(depthImage.constScanLine(sourceRow));
+            if(!sameSize){
+                for(int x=0;x<color.width;x++){
+                    overlayRow[x] = overlay[columns[x]];
+                    depthRow[x] = depthPixels[columns[x]];
+                }
+                overlay = overlayRow.data();
+                depthPixels = depthRow.data();
+            }
+            OverlayBlend::blendRow(colorPixels + size_t(row)*colorStride, overlay, depthPixels,
+                                   reinterpret_cast<uint32_t*>(buffer.data.get() + size_t(row)*buffer.stride), buffer.width,
+                                   nearMm, farMm, overlayAlpha);
+        }
+        return buffer;
+    }
+    //differences are stored off by one (see FrameDiff::depth), no change is the palette's first color
+    void setDifferenceRange(uint16_t fullScaleMm){
+        differenceColormap.setRange(1, uint16_t(std::min(65535, fullScaleMm + 1)));
+    }
+    uint16_t differenceRange() const{
+        return uint16_t(differenceColormap.farDepth() - 1);
+    }
+    //both streams of a frame against an earlier one, from the decoded frames rather than anything rendered.
+    //false when they can't be compared, a thumbnail against a full frame for one
+    bool differenceFrame(const decodedFrame& frame, const decodedFrame& earlier, decodedFrame& difference){
+        const frameBuffer& color = frame.color;
+        const frameBuffer& earlierColor = earlier.color;
+        if(color.width != earlierColor.width || color.height != earlierColor.height ||
+           frame.depth.width != earlier.depth.width || frame.depth.height != earlier.depth.height ||
+           color.format != QImage::Format_RGB888 || earlierColor.format != QImage::Format_RGB888)
+            return false;
+        QImage depth = frame.depth.image(), earlierDepth = earlier.depth.image();
+        if(depth.isNull() || earlierDepth.isNull())
+            return false;
+        auto& colorResult = difference.color;
+        colorResult.width = color.width;
+        colorResult.height = color.height;
+        colorResult.stride = color.width*3;
+        colorResult.format = QImage::Format_RGB888;
+        colorResult.ownsMemory = true;
+        colorResult.data = colorDifferenceArena.acquire(size_t(colorResult.stride)*colorResult.height);
+        for(int row=0;row<color.height;row++)
+            FrameDiff::color(color.data.get() + size_t(row)*color.stride, earlierColor.data.get() + size_t(row)*earlierColor.stride,
+                             colorResult.data.get() + size_t(row)*colorResult.stride, colorResult.stride, colorDifferenceGain);
+        auto& depthResult = difference.depth;
+        depthResult.width = depth.width();
+        depthResult.height = depth.height();
+        depthResult.stride = depthResult.width*2;
+        depthResult.format = QImage::Format_Grayscale16;
+        depthResult.ownsMemory = true;
+        depthResult.data = depthDifferenceArena.acquire(size_t(depthResult.stride)*depthResult.height);
+        for(int row=0;row<depthResult.height;row++)
+            FrameDiff::depth(reinterpret_cast<const uint16_t*>(depth.constScanLine(row)), reinterpret_cast<const uint16_t*>(earlierDepth.constScanLine(row)),
+                             reinterpret_cast<uint16_t*>(depthResult.data.get() + size_t(row)*depthResult.stride), depthResult.width);
+        return true;
+    }
+    frameBuffer colorizeDifference(const frameBuffer& difference){
+        QImage source = difference.image();
+        if(source.isNull())
+            return {};
+        frameBuffer buffer;
+        buffer.width = source.width();
+        buffer.height = source.height();
+        buffer.stride = buffer.width*4;
+        buffer.format = QImage::Format_RGB32;
+        buffer.ownsMemory = true;
+        buffer.data = depthDisplayArena.acquire(size_t(buffer.stride)*buffer.height);
+        for(int row=0;row<buffer.height;row++)
+            differenceColormap.apply(reinterpret_cast<const uint16_t*>(source.constScanLine(row)),
+                                     reinterpret_cast<uint32_t*>(buffer.data.get() + size_t(row)*buffer.stride), buffer.width);
+        return buffer;
+    }
+    //mapped frames are used in place, everything else is copied once into an arena slot
+    frameBuffer createBufferFromFrame(const rawVideoFrame& frame, int bytesPerPixel, QImage::Format format, FrameArena& arena){
+        frameBuffer buffer;
+        buffer.width = frame.width;
+        buffer.height = frame.height;
+        buffer.format = format;
+        if(frame.view){
+            buffer.stride = frame.stride;
+            buffer.data = std::shared_ptr<uchar>(frame.viewOwner, const_cast<uchar*>(frame.view));
+            return buffer;
+        }
+        const size_t rowBytes = size_t(frame.width)*bytesPerPixel;
+        buffer.stride = int(rowBytes);
+        buffer.ownsMemory = true;
+        buffer.data = arena.acquire(rowBytes*frame.height);
+        auto source = frame.data();
+        for(int row=0;row<frame.height;row++)
+            std::memcpy(buffer.data.get() + row*rowBytes, source + size_t(row)*frame.stride, rowBytes);
+        return buffer;
+    }
+    //area-averaged straight into a smaller arena slot, mapped frames included: the full-size frame is never copied
+    frameBuffer createDownscaledBuffer(const rawVideoFrame& frame, int divisor, int bytesPerPixel, QImage::Format format, FrameArena& arena){
+        divisor = std::max(1, std::min({divisor, frame.width, frame.height}));
+        frameBuffer buffer;
+        buffer.width = frame.width/divisor;
+        buffer.height = frame.height/divisor;
+        buffer.format = format;
+        buffer.stride = (buffer.width*bytesPerPixel + 3)/4*4;//odd widths come up here, QImage wants 4 byte rows
+        buffer.ownsMemory = true;
+        buffer.data = arena.acquire(size_t(buffer.stride)*buffer.height);
+        if(bytesPerPixel == 2)
+            FrameScaler::downscaleDepth(reinterpret_cast<const uint16_t*>(frame.data()), frame.width, frame.height, frame.stride,
+                                        divisor, reinterpret_cast<uint16_t*>(buffer.data.get()), buffer.stride);
+        else
+            FrameScaler::downscaleRgb888(frame.data(), frame.width, frame.height, frame.stride,
+                                         divisor, buffer.data.get(), buffer.stride);
+        return buffer;
+    }
+    //JPEG color is decoded at the display size as far as the DCT gets there, the rest is area-averaged
+    frameBuffer createDecodedColorBuffer(const rawVideoFrame& frame){
+        const int divisor = colorDivisor;
+        const int reduction = JpegDecoder::reductionFor(divisor);
+        if(divisor == reduction){
+            frameBuffer buffer;
+            buffer.width = JpegDecoder::reducedSize(frame.width, reduction);
+            buffer.height = JpegDecoder::reducedSize(frame.height, reduction);
+            buffer.stride = (buffer.width*3 + 3)/4*4;
+            buffer.format = QImage::Format_RGB888;
+            buffer.ownsMemory = true;
+            buffer.data = colorArena.acquire(size_t(buffer.stride)*buffer.height);
+            if(!frame.expandColor(buffer.data.get(), buffer.stride, reduction))
+                return {};
+            return buffer;
+        }
+        rawVideoFrame decoded = frame;
+        if(!expandColor(decoded, reduction))
+            return {};
+        return createDownscaledBuffer(decoded, divisor/reduction, 3, QImage::Format_RGB888, colorArena);
+    }
+    //for readers of raw frames other than the conversion above, the thumbnails
+    bool expandColor(rawVideoFrame& frame, int reduction) const{
+        if(!frame.isCompressed())
+            return true;
+        const int width = JpegDecoder::reducedSize(frame.width, reduction), height = JpegDecoder::reducedSize(frame.height, reduction);
+        std::vector<uint8_t> expanded(size_t(width)*3*height);
+        if(!frame.expandColor(expanded.data(), width*3, reduction))
+            return false;
+        frame.payload = std::move(expanded);
+        frame.view = nullptr;
+        frame.viewOwner.reset();
+        frame.codec = OniFileReader::CODEC_UNCOMPRESSED;
+        frame.pixelFormat = ONI_PIXEL_FORMAT_RGB888;
+        frame.width = width;
+        frame.height = height;
+        frame.stride = width*3;
+        return true;
+    }
+    //formats the views don't take are converted straight into an arena slot, or into a tight frame
+    //of their own first when they're downscaled (or compressed) after that
+    frameBuffer createConvertedBuffer(const rawVideoFrame& frame, const PixelConverter::entry& format, FrameArena& arena){
+        frameBuffer buffer;
+        buffer.width = frame.width;
+        buffer.height = frame.height;
+        buffer.stride = (frame.width*format.targetBytesPerPixel() + 3)/4*4;
+        buffer.format = format.targetFormat();
+        buffer.ownsMemory = true;
+        buffer.data = arena.acquire(size_t(buffer.stride)*buffer.height);
+        PixelConverter::convert(format, frame.data(), frame.stride, frame.width, frame.height, buffer.data.get(), buffer.stride, conversionContext());
+        return buffer;
+    }
+    rawVideoFrame convertedFrame(const rawVideoFrame& frame, const PixelConverter::entry& format) const{
+        rawVideoFrame converted;
+        converted.width = frame.width;
+        converted.height = frame.height;
+        converted.stride = frame.width*format.targetBytesPerPixel();
+        converted.pixelFormat = format.isDepth ? ONI_PIXEL_FORMAT_DEPTH_1_MM : ONI_PIXEL_FORMAT_RGB888;
+        converted.payload.resize(size_t(converted.stride)*converted.height);
+        PixelConverter::convert(format, frame.data(), frame.stride, frame.width, frame.height, converted.payload.data(), converted.stride,
+                                conversionContext());
+        return converted;
+    }
+    //for readers of raw frames other than the conversions here, the thumbnails; compressed frames are expanded first
+    void convertPixels(rawVideoFrame& frame, bool isDepth) const{
+        auto& format = PixelConverter::forFormat(frame.pixelFormat, isDepth);
+        if(format.convertRow && !frame.isCompressed())
+            frame = convertedFrame(frame, format);
+    }
+    inline frameBuffer createColorBufferFromFrame(const rawVideoFrame& frame){
+        if(frame.isCompressed())
+            return createDecodedColorBuffer(frame);
+        auto& format = PixelConverter::forFormat(frame.pixelFormat, false);
+        if(format.convertRow){
+            if(colorDivisor > 1)
+                return createColorBufferFromFrame(convertedFrame(frame, format));
+            return createConvertedBuffer(frame, format, colorArena);
+        }
+        if(colorDivisor > 1)
+            return createDownscaledBuffer(frame, colorDivisor, 3, QImage::Format_RGB888, colorArena);
+        return createBufferFromFrame(frame, 3, QImage::Format_RGB888, colorArena);
+    }
+    //GRAY16 IR is cached as it is and gained when it's shown, any other format is converted like color
+    frameBuffer createIrBufferFromFrame(const rawVideoFrame& frame){
+        const int divisor = irDivisor;
+        if(frame.isCompressed()){
+            rawVideoFrame decoded = frame;
+            if(!expandColor(decoded, 1))
+                return {};
+            return createIrBufferFromFrame(decoded);
+        }
+        if(frame.pixelFormat == ONI_PIXEL_FORMAT_GRAY16){
+            if(divisor > 1)
+                return createDownscaledBuffer(frame, divisor, 2, QImage::Format_Grayscale16, irArena);
+            return createBufferFromFrame(frame, 2, QImage::Format_Grayscale16, irArena);
+        }
+        auto& format = PixelConverter::forFormat(frame.pixelFormat, false);
+        if(!format.convertRow){
+            if(divisor > 1)
+                return createDownscaledBuffer(frame, divisor, 3, QImage::Format_RGB888, irArena);
+            return createBufferFromFrame(frame, 3, QImage::Format_RGB888, irArena);
+        }
+        if(divisor > 1)
+            return createDownscaledBuffer(convertedFrame(frame, format), divisor, 3, QImage::Format_RGB888, irArena);
+        return createConvertedBuffer(frame, format, irArena);
+    }
+    //IR as it's shown: GRAY16 stretched over the range of the frames shown lately, which follows each
+    //frame's own range quickly but not at once, so a single bright frame doesn't flash the ones around it
+    frameBuffer gainIr(const frameBuffer& ir){
+        if(ir.format != QImage::Format_Grayscale16 || !ir.data)
+            return ir;
+        uint16_t low = 65535, high = 0;
+        for(int row=0;row<ir.height;row++)
+            IrGain::range(reinterpret_cast<const uint16_t*>(ir.data.get() + size_t(row)*ir.stride), ir.width, low, high);
+        if(irHigh <= irLow){
+            irLow = low;
+            irHigh = high;
+        }
+        else{
+            irLow += (low - irLow)*0.5f;
+            irHigh += (high - irHigh)*0.5f;
+        }
+        frameBuffer buffer;
+        buffer.width = ir.width;
+        buffer.height = ir.height;
+        buffer.stride = (ir.width + 3)/4*4;
+        buffer.format = QImage::Format_Grayscale8;
+        buffer.ownsMemory = true;
+        buffer.data = irDisplayArena.acquire(size_t(buffer.stride)*buffer.height);
+        const float gain = 255.f/std::max(1.f, irHigh - irLow);
+        for(int row=0;row<ir.height;row++)
+            IrGain::apply(reinterpret_cast<const uint16_t*>(ir.data.get() + size_t(row)*ir.stride),
+                          buffer.data.get() + size_t(row)*buffer.stride, ir.width, uint16_t(irLow), gain);
+        return buffer;
+    }
+    //for readers of raw frames other than the conversion below, the thumbnails
+    bool expandDepth(rawVideoFrame& frame) const{
+        if(!frame.isCompressed())
+            return true;
+        std::vector<uint8_t> expanded(size_t(frame.width)*frame.height*2);
+        if(!frame.expandDepth(reinterpret_cast<uint16_t*>(expanded.data())))
+            return false;
+        frame.payload = std::move(expanded);
+        frame.view = nullptr;
+        frame.viewOwner.reset();
+        frame.codec = OniFileReader::CODEC_UNCOMPRESSED;
+        frame.stride = frame.width*2;
+        return true;
+    }
+    //compressed depth is decoded right into its arena slot, or first into a tight frame of its own
+    //when it's converted, downscaled or compressed again after that
+    frameBuffer createExpandedDepthBuffer(const rawVideoFrame& frame){
+        if(depthDivisor > 1 || compressDepth || PixelConverter::forFormat(frame.pixelFormat, true).convertRow){
+            rawVideoFrame expanded;
+            expanded.pixelFormat = frame.pixelFormat;
+            expanded.width = frame.width;
+            expanded.height = frame.height;
+            expanded.stride = frame.width*2;
+            expanded.payload.resize(size_t(expanded.stride)*expanded.height);
+            if(!frame.expandDepth(reinterpret_cast<uint16_t*>(expanded.payload.data())))
+                return {};
+            return createDepthBufferFromFrame(expanded);
+        }
+        frameBuffer buffer;
+        buffer.width = frame.width;
+        buffer.height = frame.height;
+        buffer.stride = frame.width*2;
+        buffer.format = QImage::Format_Grayscale16;
+        buffer.ownsMemory = true;
+        buffer.data = depthArena.acquire(size_t(buffer.stride)*buffer.height);
+        if(!frame.expandDepth(reinterpret_cast<uint16_t*>(buffer.data.get())))
+            return {};
+        return buffer;
+    }
+    inline frameBuffer createDepthBufferFromFrame(const rawVideoFrame& frame){
+        if(frame.isCompressed())
+            return createExpandedDepthBuffer(frame);
+        auto& format = PixelConverter::forFormat(frame.pixelFormat, true);
+        if(format.convertRow){
+            if(depthDivisor > 1 || compressDepth)
+                return createDepthBufferFromFrame(convertedFrame(frame, format));
+            return createConvertedBuffer(frame, format, depthArena);
+        }
+        if(depthDivisor > 1){
+            auto scaled = createDownscaledBuffer(frame, depthDivisor, 2, QImage::Format_Grayscale16, depthArena);
+            if(!compressDepth)
+                return scaled;
+            return createCompressedDepthBuffer(scaled.data.get(), scaled.width, scaled.height, scaled.stride);
+        }
+        if(compressDepth && !frame.view)
+            return createCompressedDepthBuffer(frame.data(), frame.width, frame.height, frame.stride);
+        return createBufferFromFrame(frame, 2, QImage::Format_Grayscale16, depthArena);
     }
-    inline QGraphicsPixmapItem* createDepthPixMapFromFrame(openni::VideoFrameRef& frame){
-        auto newPixmapItem = new QGraphicsPixmapItem();
-        newPixmapItem->setPixmap(QPixmap::fromImage(QImage((uchar*)frame.getData(),frame.getWidth(),frame.getHeight(),QImage::Format_Grayscale16)));
-        return newPixmapItem;
+    //mapped frames cost nothing already, so only copied or downscaled depth is worth compressing
+    frameBuffer createCompressedDepthBuffer(const uchar* pixels, int width, int height, int stride){
+        auto start = std::chrono::steady_clock::now();
+        frameBuffer buffer;
+        buffer.width = width;
+        buffer.height = height;
+        buffer.stride = width*2;
+        buffer.format = QImage::Format_Grayscale16;
+        buffer.ownsMemory = true;
+        buffer.stats = compressionStats;
+        buffer.compressed = std::make_shared<const std::vector<uint8_t>>(
+            DepthCodec::encode(reinterpret_cast<const uint16_t*>(pixels), width, height, stride));
+        buffer.stats->rawBytes += size_t(buffer.stride)*buffer.height;
+        buffer.stats->storedBytes += buffer.compressed->size();
+        buffer.stats->encodeNanoseconds += std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start).count();
+        buffer.stats->framesEncoded++;
+        return buffer;
     }
 };
 
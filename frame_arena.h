@@ -0,0 +1,78 @@
+#ifndef FRAME_ARENA_H
+#define FRAME_ARENA_H
+
+#include <QMutex>
+#include <QMutexLocker>
+
+#include <algorithm>
+#include <memory>
+#include <vector>
+
+//slab allocator with fixed-size slots, one arena per stream since every video mode has its own frame size.
+//slots are handed out as shared_ptrs which give the slot back on release; reset() just swaps the whole
+//state out, so closing a file doesn't walk frames. slabs still referenced somewhere go away with their last slot
+class FrameArena {
+    struct state{
+        size_t slotSize = 0;
+        size_t slotsPerSlab = 0;
+        std::vector<std::unique_ptr<uchar[]>> slabs;
+        std::vector<uchar*> freeSlots;
+        QMutex mutex;
+    };
+    static constexpr size_t slotAlignment = 64;
+    static constexpr size_t slabBytes = size_t(64)<<20;
+
+    std::shared_ptr<state> current;
+    mutable QMutex stateSwap;
+
+    static void growSlab(state& arena){
+        arena.slabs.emplace_back(new uchar[arena.slotSize*arena.slotsPerSlab + slotAlignment]);
+        auto base = arena.slabs.back().get();
+        base += (slotAlignment - reinterpret_cast<uintptr_t>(base) % slotAlignment) % slotAlignment;
+        for(size_t i=arena.slotsPerSlab;i-->0;)
+            arena.freeSlots.push_back(base + i*arena.slotSize);
+    }
+    std::shared_ptr<state> snapshot() const{
+        QMutexLocker locker(&stateSwap);
+        return current;
+    }
+public:
+    FrameArena(): current(std::make_shared<state>()) {}
+
+    //the first request decides the slot size; anything bigger than that (video mode changed mid-file)
+    //falls back to a plain heap buffer
+    std::shared_ptr<uchar> acquire(size_t bytes){
+        auto arena = snapshot();
+        QMutexLocker locker(&arena->mutex);
+        if(!arena->slotSize){
+            arena->slotSize = (bytes + slotAlignment - 1)/slotAlignment*slotAlignment;
+            arena->slotsPerSlab = std::max<size_t>(1, slabBytes/arena->slotSize);
+        }
+        if(bytes > arena->slotSize)
+            return std::shared_ptr<uchar>(new uchar[bytes], std::default_delete<uchar[]>());
+        if(arena->freeSlots.empty())
+            growSlab(*arena);
+        auto slot = arena->freeSlots.back();
+        arena->freeSlots.pop_back();
+        return std::shared_ptr<uchar>(slot, [arena](uchar* released){
+            QMutexLocker locker(&arena->mutex);
+            arena->freeSlots.push_back(released);
+        });
+    }
+    void reset(){
+        QMutexLocker locker(&stateSwap);
+        current = std::make_shared<state>();
+    }
+    size_t slotSize() const{
+        auto arena = snapshot();
+        QMutexLocker locker(&arena->mutex);
+        return arena->slotSize;
+    }
+    size_t reservedBytes() const{
+        auto arena = snapshot();
+        QMutexLocker locker(&arena->mutex);
+        return arena->slabs.size()*arena->slotsPerSlab*arena->slotSize;
+    }
+};
+
+#endif // FRAME_ARENA_H
@@ -0,0 +1,93 @@
+#ifndef FRAME_CACHE_H
+#define FRAME_CACHE_H
+
+#include <QMutex>
+#include <QMutexLocker>
+
+#include <list>
+#include <optional>
+#include <unordered_map>
+
+//byte-budgeted LRU, the caller tells how much every value weighs when putting it in
+//the newest entry always stays, even if it alone doesn't fit into the budget
+template<typename Key, typename Value>
+class LruCache {
+    struct entry{
+        Key key;
+        Value value;
+        size_t bytes;
+    };
+    using entryList = std::list<entry>;
+
+    entryList order;//front is the most recently used one
+    std::unordered_map<Key, typename entryList::iterator> lookup;
+    size_t budgetBytes;
+    size_t usedBytes;
+    mutable QMutex mutex;
+
+    void evictToFit(size_t incomingBytes){
+        while(!order.empty() && usedBytes + incomingBytes > budgetBytes){
+            usedBytes -= order.back().bytes;
+            lookup.erase(order.back().key);
+            order.pop_back();
+        }
+    }
+public:
+    explicit LruCache(size_t budgetBytes): budgetBytes(budgetBytes), usedBytes(0) {}
+
+    std::optional<Value> get(const Key& key){
+        QMutexLocker locker(&mutex);
+        auto it = lookup.find(key);
+        if(it == lookup.end())
+            return std::nullopt;
+        order.splice(order.begin(), order, it->second);
+        return it->second->value;
+    }
+    bool contains(const Key& key) const{
+        QMutexLocker locker(&mutex);
+        return lookup.count(key);
+    }
+    void put(const Key& key, const Value& value, size_t bytes){
+        QMutexLocker locker(&mutex);
+        auto it = lookup.find(key);
+        if(it != lookup.end()){
+            usedBytes -= it->second->bytes;
+            order.erase(it->second);
+            lookup.erase(it);
+        }
+        evictToFit(bytes);
+        order.push_front({key, value, bytes});
+        lookup[key] = order.begin();
+        usedBytes += bytes;
+    }
+    //true if a value of that weight can be added without pushing anything out
+    bool hasRoomFor(size_t bytes) const{
+        QMutexLocker locker(&mutex);
+        return usedBytes + bytes <= budgetBytes;
+    }
+    void setBudget(size_t bytes){
+        QMutexLocker locker(&mutex);
+        budgetBytes = bytes;
+        evictToFit(0);
+    }
+    size_t budget() const{
+        QMutexLocker locker(&mutex);
+        return budgetBytes;
+    }
+    size_t used() const{
+        QMutexLocker locker(&mutex);
+        return usedBytes;
+    }
+    size_t count() const{
+        QMutexLocker locker(&mutex);
+        return order.size();
+    }
+    void clear(){
+        QMutexLocker locker(&mutex);
+        lookup.clear();
+        order.clear();
+        usedBytes = 0;
+    }
+};
+
+#endif // FRAME_CACHE_H
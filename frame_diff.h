@@ -0,0 +1,91 @@
+#ifndef FRAME_DIFF_H
+#define FRAME_DIFF_H
+
+#include <QtGlobal>
+
+#include <algorithm>
+#include <cstdint>
+
+#if defined(__AVX2__)
+#include <immintrin.h>
+#define FRAME_DIFF_AVX2
+#endif
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define FRAME_DIFF_SSE2
+#endif
+
+//absolute differences of two frames of the same size. the unsigned |a - b| is (a -sat b) | (b -sat a)
+class FrameDiff {
+public:
+    //0 where either depth is missing, |a - b| + 1 otherwise, so no change stays apart from no depth
+    //and the result goes through a DepthColormap as it is. differences of 65535 mm and up saturate
+    static void depth(const uint16_t* a, const uint16_t* b, uint16_t* out, int count){
+        int i = 0;
+#if defined(FRAME_DIFF_AVX2)
+        const __m256i zero = _mm256_setzero_si256();
+        const __m256i one = _mm256_set1_epi16(1);
+        for(;i+16<=count;i+=16){
+            __m256i x = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(a + i));
+            __m256i y = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(b + i));
+            __m256i difference = _mm256_adds_epu16(_mm256_or_si256(_mm256_subs_epu16(x, y), _mm256_subs_epu16(y, x)), one);
+            __m256i missing = _mm256_or_si256(_mm256_cmpeq_epi16(x, zero), _mm256_cmpeq_epi16(y, zero));
+            _mm256_storeu_si256(reinterpret_cast<__m256i*>(out + i), _mm256_andnot_si256(missing, difference));
+        }
+#elif defined(FRAME_DIFF_SSE2)
+        const __m128i zero = _mm_setzero_si128();
+        const __m128i one = _mm_set1_epi16(1);
+        for(;i+8<=count;i+=8){
+            __m128i x = _mm_loadu_si128(reinterpret_cast<const __m128i*>(a + i));
+            __m128i y = _mm_loadu_si128(reinterpret_cast<const __m128i*>(b + i));
+            __m128i difference = _mm_adds_epu16(_mm_or_si128(_mm_subs_epu16(x, y), _mm_subs_epu16(y, x)), one);
+            __m128i missing = _mm_or_si128(_mm_cmpeq_epi16(x, zero), _mm_cmpeq_epi16(y, zero));
+            _mm_storeu_si128(reinterpret_cast<__m128i*>(out + i), _mm_andnot_si128(missing, difference));
+        }
+#endif
+        for(;i<count;i++){
+            if(!a[i] || !b[i])
+                out[i] = 0;
+            else
+                out[i] = uint16_t(std::min(65535, (a[i] > b[i] ? a[i] - b[i] : b[i] - a[i]) + 1));
+        }
+    }
+    //per channel |a - b|, multiplied by 2^gainShift (saturating) so small changes are visible
+    static void color(const uchar* a, const uchar* b, uchar* out, int bytes, int gainShift){
+        int i = 0;
+#if defined(FRAME_DIFF_AVX2)
+        for(;i+32<=bytes;i+=32){
+            __m256i x = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(a + i));
+            __m256i y = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(b + i));
+            __m256i difference = _mm256_or_si256(_mm256_subs_epu8(x, y), _mm256_subs_epu8(y, x));
+            for(int step=0;step<gainShift;step++)
+                difference = _mm256_adds_epu8(difference, difference);
+            _mm256_storeu_si256(reinterpret_cast<__m256i*>(out + i), difference);
+        }
+#elif defined(FRAME_DIFF_SSE2)
+        for(;i+16<=bytes;i+=16){
+            __m128i x = _mm_loadu_si128(reinterpret_cast<const __m128i*>(a + i));
+            __m128i y = _mm_loadu_si128(reinterpret_cast<const __m128i*>(b + i));
+            __m128i difference = _mm_or_si128(_mm_subs_epu8(x, y), _mm_subs_epu8(y, x));
+            for(int step=0;step<gainShift;step++)
+                difference = _mm_adds_epu8(difference, difference);
+            _mm_storeu_si128(reinterpret_cast<__m128i*>(out + i), difference);
+        }
+#endif
+        for(;i<bytes;i++){
+            const int difference = a[i] > b[i] ? a[i] - b[i] : b[i] - a[i];
+            out[i] = uchar(std::min(255, difference << gainShift));
+        }
+    }
+    static const char* kernelName(){
+#if defined(FRAME_DIFF_AVX2)
+        return "AVX2";
+#elif defined(FRAME_DIFF_SSE2)
+        return "SSE2";
+#else
+        return "scalar";
+#endif
+    }
+};
+
+#endif // FRAME_DIFF_H
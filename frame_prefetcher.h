@@ -0,0 +1,182 @@
+#ifndef FRAME_PREFETCHER_H
+#define FRAME_PREFETCHER_H
+
+#include <QMutex>
+#include <QMutexLocker>
+#include <QWaitCondition>
+
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <thread>
+#include <vector>
+
+#include "device_vstream_info.h"
+
+//keeps the frames playback is about to show decoded ahead of time.
+//the window follows the frames actually shown: their direction and how many frames a tick advances,
+//so fast-forward and stepping backwards prefetch the right ones too. decoded frames are pinned in a ring
+//of fixed size, the cache budget can't evict them before they're shown
+class FramePrefetcher {
+    struct slot{
+        int64_t index = -1;
+        decodedFrame frame;
+        bool ready = false;
+        bool filling = false;
+    };
+    static constexpr size_t defaultDepth = 16;
+    static constexpr size_t defaultWorkers = 2;
+
+    deviceVStreamInfo& source;
+    std::vector<slot> ring;
+    std::vector<int64_t> wanted;//nearest first
+    int64_t lastFrame;
+    double velocity;//frames per update, smoothed while playing
+    bool playing;
+    bool stopping;
+    size_t busy;
+    QMutex mutex;
+    QWaitCondition changed;
+    QWaitCondition idle;
+    std::vector<std::thread> workers;
+    std::atomic<uint64_t> hitCount{0};
+    std::atomic<uint64_t> missCount{0};
+
+    bool isWanted(int64_t index) const{
+        return std::find(wanted.begin(), wanted.end(), index) != wanted.end();
+    }
+    bool inRing(int64_t index) const{
+        return std::any_of(ring.begin(), ring.end(), [index](const slot& s){ return s.index == index; });
+    }
+    //next wanted frame that isn't in the ring yet, together with a slot nobody needs anymore
+    bool claim(int64_t& index, size_t& slotIndex){
+        for(auto candidate: wanted){
+            if(inRing(candidate))
+                continue;
+            for(size_t i=0;i<ring.size();i++){
+                if(ring[i].filling || isWanted(ring[i].index))
+                    continue;
+                ring[i] = slot();
+                ring[i].index = candidate;
+                ring[i].filling = true;
+                index = candidate;
+                slotIndex = i;
+                return true;
+            }
+            return false;//the ring is full of frames still ahead
+        }
+        return false;
+    }
+    void workerLoop(){
+        QMutexLocker locker(&mutex);
+        while(true){
+            int64_t index;
+            size_t slotIndex;
+            while(!stopping && !claim(index, slotIndex))
+                changed.wait(&mutex);
+            if(stopping)
+                return;
+            busy++;
+            locker.unlock();
+            auto frame = source.frameAt(size_t(index));
+            locker.relock();
+            //failed frames keep their slot, so they aren't retried on every wakeup
+            ring[slotIndex].frame = frame;
+            ring[slotIndex].ready = frame.isValid();
+            ring[slotIndex].filling = false;
+            if(--busy == 0)
+                idle.wakeAll();
+        }
+    }
+    void rebuildWindow(int64_t current){
+        wanted.clear();
+        const int64_t framesCount = int64_t(source.framesCount);
+        if(current < 0 || current >= framesCount)
+            return;
+        const int64_t direction = velocity < 0 ? -1 : 1;
+        const int64_t stride = std::max<int64_t>(1, std::llround(std::abs(velocity)));
+        for(size_t k=0;k<ring.size();k++){
+            int64_t index = current + direction*stride*int64_t(k);
+            if(index < 0 || index >= framesCount)
+                break;
+            wanted.push_back(index);
+        }
+    }
+public:
+    explicit FramePrefetcher(deviceVStreamInfo& source):
+        source(source), ring(defaultDepth), lastFrame(-1), velocity(1), playing(false), stopping(false), busy(0)
+    {
+        for(size_t i=0;i<defaultWorkers;i++)
+            workers.emplace_back([this](){ workerLoop(); });
+    }
+    ~FramePrefetcher(){
+        {
+            QMutexLocker locker(&mutex);
+            stopping = true;
+            changed.wakeAll();
+        }
+        for(auto& worker: workers)
+            worker.join();
+    }
+    //called with every frame that gets shown
+    void update(int64_t current, bool isPlaying){
+        QMutexLocker locker(&mutex);
+        if(lastFrame >= 0 && current != lastFrame){
+            double step = double(current - lastFrame);
+            //playback jitters between 1 and 2 frames per tick, stepping by hand just sets the direction
+            velocity = isPlaying && playing ? 0.7*velocity + 0.3*step : (step < 0 ? -1 : 1);
+        }
+        lastFrame = current;
+        playing = isPlaying;
+        rebuildWindow(current);
+        changed.wakeAll();
+    }
+    //true and the frame if it was decoded ahead; misses are counted while playing only
+    bool lookup(int64_t index, decodedFrame& frame){
+        QMutexLocker locker(&mutex);
+        for(auto& s: ring){
+            if(s.index == index && s.ready){
+                frame = s.frame;
+                hitCount++;
+                return true;
+            }
+        }
+        if(playing)
+            missCount++;
+        return false;
+    }
+    //drops everything and waits for decodes in progress, the recording can be closed afterwards
+    void reset(){
+        QMutexLocker locker(&mutex);
+        wanted.clear();
+        while(busy)
+            idle.wait(&mutex);
+        ring.assign(ring.size(), slot());
+        lastFrame = -1;
+        velocity = 1;
+        playing = false;
+        hitCount = 0;
+        missCount = 0;
+    }
+    void setDepth(size_t depth){
+        QMutexLocker locker(&mutex);
+        wanted.clear();
+        while(busy)
+            idle.wait(&mutex);
+        ring.assign(std::max<size_t>(1, depth), slot());
+        rebuildWindow(lastFrame);
+        changed.wakeAll();
+    }
+    size_t depth(){
+        QMutexLocker locker(&mutex);
+        return ring.size();
+    }
+    uint64_t hits() const{
+        return hitCount;
+    }
+    uint64_t misses() const{
+        return missCount;
+    }
+};
+
+#endif // FRAME_PREFETCHER_H
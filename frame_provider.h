@@ -0,0 +1,131 @@
+#ifndef FRAME_PROVIDER_H
+#define FRAME_PROVIDER_H
+
+#include <QMutex>
+#include <QMutexLocker>
+#include <QWaitCondition>
+
+#include <algorithm>
+#include <deque>
+#include <functional>
+#include <future>
+#include <memory>
+#include <thread>
+#include <vector>
+
+#include "device_vstream_info.h"
+
+//hands out single frames by index: cache hits are answered right away,
+//misses are queued for a worker thread which seeks the recording and decodes just that frame
+class FrameProvider {
+public:
+    //called on the requesting thread for cache hits and on the worker thread otherwise
+    using readyCallback = std::function<void(size_t index, const decodedFrame& frame)>;
+private:
+    struct request{
+        size_t index;
+        std::promise<decodedFrame> promise;
+        std::shared_future<decodedFrame> future;
+        std::vector<readyCallback> callbacks;
+        request(size_t index): index(index), future(promise.get_future().share()) {}
+    };
+    deviceVStreamInfo& source;
+    std::deque<std::shared_ptr<request>> pending;
+    std::shared_ptr<request> inFlight;
+    QMutex queueMutex;
+    QWaitCondition queueChanged;
+    QWaitCondition requestDone;
+    bool stopping;
+    std::thread worker;
+
+    //dropped requests get an empty frame and their callbacks are never called
+    static void drop(request& req){
+        req.promise.set_value({});
+    }
+    void workerLoop(){
+        while(true){
+            std::shared_ptr<request> current;
+            {
+                QMutexLocker locker(&queueMutex);
+                while(!stopping && pending.empty())
+                    queueChanged.wait(&queueMutex);
+                if(stopping)
+                    return;
+                current = inFlight = pending.front();
+                pending.pop_front();
+            }
+            auto frame = source.frameAt(current->index);
+            std::vector<readyCallback> callbacks;
+            {
+                QMutexLocker locker(&queueMutex);
+                inFlight.reset();
+                requestDone.wakeAll();
+                callbacks.swap(current->callbacks);
+            }
+            current->promise.set_value(frame);
+            for(auto& callback: callbacks)
+                callback(current->index, frame);
+        }
+    }
+public:
+    explicit FrameProvider(deviceVStreamInfo& source):
+        source(source), stopping(false),
+        worker([this](){ workerLoop(); })
+    {}
+    ~FrameProvider(){
+        {
+            QMutexLocker locker(&queueMutex);
+            stopping = true;
+            for(auto& req: pending)
+                drop(*req);
+            pending.clear();
+            queueChanged.wakeAll();
+        }
+        worker.join();
+    }
+    //supersede drops every queued request for other frames, which is what scrubbing wants:
+    //only the latest position matters, the worker shouldn't chew through the whole backlog
+    std::shared_future<decodedFrame> requestFrame(size_t index, readyCallback onReady = {}, bool supersede = true){
+        if(auto cached = source.frameCache.get(index)){
+            std::promise<decodedFrame> ready;
+            ready.set_value(*cached);
+            if(onReady)
+                onReady(index, *cached);
+            return ready.get_future().share();
+        }
+        QMutexLocker locker(&queueMutex);
+        if(supersede){
+            for(auto& req: pending)
+                if(req->index != index)
+                    drop(*req);
+            pending.erase(std::remove_if(pending.begin(), pending.end(),
+                                         [index](const std::shared_ptr<request>& req){ return req->index != index; }),
+                          pending.end());
+        }
+        std::shared_ptr<request> target;
+        if(inFlight && inFlight->index == index)
+            target = inFlight;
+        for(auto& req: pending)
+            if(!target && req->index == index)
+                target = req;
+        if(!target){
+            target = std::make_shared<request>(index);
+            pending.push_back(target);
+            queueChanged.wakeOne();
+        }
+        if(onReady)
+            target->callbacks.push_back(onReady);
+        return target->future;
+    }
+    //blocks until the in-flight decode (if any) is done, so the streams can be torn down afterwards
+    void cancelPending(){
+        QMutexLocker locker(&queueMutex);
+        for(auto& req: pending)
+            drop(*req);
+        pending.clear();
+        while(inFlight)
+            requestDone.wait(&queueMutex);
+    }
+};
+
+#endif // FRAME_PROVIDER_H
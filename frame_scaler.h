@@ -0,0 +1,118 @@
+#ifndef FRAME_SCALER_H
+#define FRAME_SCALER_H
+
+#include <QtGlobal>
+
+#include <cstdint>
+#include <cstring>
+#include <vector>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define FRAME_SCALER_SSE2
+#endif
+
+//area-average downscaling by whole factors, strides are in bytes.
+//a partial block at the right or bottom edge is dropped, output sizes are width/factor x height/factor.
+//the rows of a block are summed column-wise first (vectorized, that's nearly all the work),
+//then every factor columns are folded into one output pixel
+class FrameScaler {
+    //column sums of bytes, 32 bits so that no factor a frame has room for overflows them
+    static void accumulateBytes(const uchar* row, uint32_t* sums, int count){
+        int i = 0;
+#if defined(FRAME_SCALER_SSE2)
+        const __m128i zero = _mm_setzero_si128();
+        for(;i+16<=count;i+=16){
+            __m128i bytes = _mm_loadu_si128(reinterpret_cast<const __m128i*>(row + i));
+            __m128i words[2] = {_mm_unpacklo_epi8(bytes, zero), _mm_unpackhi_epi8(bytes, zero)};
+            for(int half=0;half<2;half++){
+                __m128i* low = reinterpret_cast<__m128i*>(sums + i + half*8);
+                __m128i* high = reinterpret_cast<__m128i*>(sums + i + half*8 + 4);
+                _mm_storeu_si128(low, _mm_add_epi32(_mm_loadu_si128(low), _mm_unpacklo_epi16(words[half], zero)));
+                _mm_storeu_si128(high, _mm_add_epi32(_mm_loadu_si128(high), _mm_unpackhi_epi16(words[half], zero)));
+            }
+        }
+#endif
+        for(;i<count;i++)
+            sums[i] += row[i];
+    }
+    //column sums of depth and how many of the values were valid (non-zero)
+    static void accumulateDepth(const uint16_t* row, uint32_t* sums, uint32_t* valid, int count){
+        int i = 0;
+#if defined(FRAME_SCALER_SSE2)
+        const __m128i zero = _mm_setzero_si128();
+        const __m128i one = _mm_set1_epi16(1);
+        for(;i+8<=count;i+=8){
+            __m128i depth = _mm_loadu_si128(reinterpret_cast<const __m128i*>(row + i));
+            __m128i* low = reinterpret_cast<__m128i*>(sums + i);
+            __m128i* high = reinterpret_cast<__m128i*>(sums + i + 4);
+            __m128i* lowCounts = reinterpret_cast<__m128i*>(valid + i);
+            __m128i* highCounts = reinterpret_cast<__m128i*>(valid + i + 4);
+            _mm_storeu_si128(low, _mm_add_epi32(_mm_loadu_si128(low), _mm_unpacklo_epi16(depth, zero)));
+            _mm_storeu_si128(high, _mm_add_epi32(_mm_loadu_si128(high), _mm_unpackhi_epi16(depth, zero)));
+            //+1, or +1-1 where the depth is zero
+            __m128i counts = _mm_add_epi16(one, _mm_cmpeq_epi16(depth, zero));
+            _mm_storeu_si128(lowCounts, _mm_add_epi32(_mm_loadu_si128(lowCounts), _mm_unpacklo_epi16(counts, zero)));
+            _mm_storeu_si128(highCounts, _mm_add_epi32(_mm_loadu_si128(highCounts), _mm_unpackhi_epi16(counts, zero)));
+        }
+#endif
+        for(;i<count;i++){
+            sums[i] += row[i];
+            valid[i] += row[i] != 0;
+        }
+    }
+public:
+    static void downscaleRgb888(const uchar* source, int width, int height, int stride, int factor,
+                                uchar* target, int targetStride){
+        const int targetWidth = width/factor;
+        const int targetHeight = height/factor;
+        const int usedBytes = targetWidth*factor*3;
+        const uint64_t area = uint64_t(factor)*factor;
+        std::vector<uint32_t> sums(usedBytes);
+        for(int ty=0;ty<targetHeight;ty++){
+            std::fill(sums.begin(), sums.end(), 0);
+            for(int y=0;y<factor;y++)
+                accumulateBytes(source + size_t(ty*factor + y)*stride, sums.data(), usedBytes);
+            uchar* out = target + size_t(ty)*targetStride;
+            for(int tx=0;tx<targetWidth;tx++){
+                uint64_t r = 0, g = 0, b = 0;
+                const uint32_t* block = sums.data() + size_t(tx)*factor*3;
+                for(int x=0;x<factor;x++){
+                    r += block[x*3];
+                    g += block[x*3 + 1];
+                    b += block[x*3 + 2];
+                }
+                out[tx*3] = uchar((r + area/2)/area);
+                out[tx*3 + 1] = uchar((g + area/2)/area);
+                out[tx*3 + 2] = uchar((b + area/2)/area);
+            }
+        }
+    }
+    //zero is "no depth" and stays out of the average, a block without any depth stays zero
+    static void downscaleDepth(const uint16_t* source, int width, int height, int stride, int factor,
+                               uint16_t* target, int targetStride){
+        const int targetWidth = width/factor;
+        const int targetHeight = height/factor;
+        const int usedWidth = targetWidth*factor;
+        std::vector<uint32_t> sums(usedWidth);
+        std::vector<uint32_t> valid(usedWidth);
+        for(int ty=0;ty<targetHeight;ty++){
+            std::fill(sums.begin(), sums.end(), 0);
+            std::fill(valid.begin(), valid.end(), 0);
+            for(int y=0;y<factor;y++)
+                accumulateDepth(reinterpret_cast<const uint16_t*>(reinterpret_cast<const uchar*>(source) + size_t(ty*factor + y)*stride),
+                                sums.data(), valid.data(), usedWidth);
+            auto out = reinterpret_cast<uint16_t*>(reinterpret_cast<uchar*>(target) + size_t(ty)*targetStride);
+            for(int tx=0;tx<targetWidth;tx++){
+                uint64_t sum = 0, count = 0;
+                for(int x=tx*factor;x<(tx + 1)*factor;x++){
+                    sum += sums[x];
+                    count += valid[x];
+                }
+                out[tx] = uint16_t(count ? (sum + count/2)/count : 0);
+            }
+        }
+    }
+};
+
+#endif // FRAME_SCALER_H
@@ -0,0 +1,60 @@
+#ifndef FRAME_SURFACE_ITEM_H
+#define FRAME_SURFACE_ITEM_H
+
+#include <QGraphicsItem>
+#include <QStyleOptionGraphicsItem>
+#include <QPainter>
+#include <QElapsedTimer>
+#include <QImage>
+
+#include <cstdint>
+
+#include "device_vstream_info.h"
+
+//the one item a view shows for the whole session. a new frame only swaps the buffer it paints from,
+//the geometry (and with it the scene's index and the view's fit) changes only with the frame size.
+//the buffer is drawn as it is, there's no QPixmap conversion and no copy of the pixels
+class FrameSurfaceItem : public QGraphicsItem {
+    frameBuffer buffer;//keeps the pixels behind image alive
+    QImage image;
+    uint64_t paintNanoseconds;
+    uint64_t paintCount;
+public:
+    FrameSurfaceItem(): paintNanoseconds(0), paintCount(0) {}
+    QRectF boundingRect() const override{
+        return QRectF(0, 0, image.width(), image.height());
+    }
+    void paint(QPainter* painter, const QStyleOptionGraphicsItem*, QWidget*) override{
+        QElapsedTimer timer;
+        timer.start();
+        painter->drawImage(0, 0, image);
+        paintNanoseconds += timer.nsecsElapsed();
+        paintCount++;
+    }
+    //true if the size changed, the view has to fit it again then
+    bool setFrame(const frameBuffer& frame){
+        auto newImage = frame.image();
+        const bool resized = newImage.size() != image.size();
+        if(resized)
+            prepareGeometryChange();
+        buffer = frame;
+        image = newImage;
+        update();
+        return resized;
+    }
+    void clear(){
+        prepareGeometryChange();
+        buffer = frameBuffer();
+        image = QImage();
+        update();
+    }
+    double averagePaintMs() const{
+        return paintCount ? paintNanoseconds/1e6/paintCount : 0.;
+    }
+    void resetStats(){
+        paintNanoseconds = 0;
+        paintCount = 0;
+    }
+};
+
+#endif // FRAME_SURFACE_ITEM_H
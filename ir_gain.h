@@ -0,0 +1,76 @@
+#ifndef IR_GAIN_H
+#define IR_GAIN_H
+
+#include <QtGlobal>
+
+#include <cstdint>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define IR_GAIN_SSE2
+#endif
+
+//GRAY16 IR to 8 bit gray, stretched over the range the frame actually uses: IR is 10 bit at most and
+//mostly much darker than that, shown as it is it's nearly black. one pass finds the range, one applies
+//out = (value - low)*gain, saturated. 8 pixels a step, the multiply is in floats so both paths round alike
+class IrGain {
+public:
+    //widens low..high to cover count more values
+    static void range(const uint16_t* values, int count, uint16_t& low, uint16_t& high){
+        int i = 0;
+#if defined(IR_GAIN_SSE2)
+        if(count >= 8){
+            //SSE2 only has signed 16 bit min/max, values go through the sign bit and back
+            const __m128i bias = _mm_set1_epi16(short(0x8000));
+            __m128i lowest = _mm_set1_epi16(short(low ^ 0x8000));
+            __m128i highest = _mm_set1_epi16(short(high ^ 0x8000));
+            for(;i+8<=count;i+=8){
+                __m128i x = _mm_xor_si128(_mm_loadu_si128(reinterpret_cast<const __m128i*>(values + i)), bias);
+                lowest = _mm_min_epi16(lowest, x);
+                highest = _mm_max_epi16(highest, x);
+            }
+            //folding halves, the byte shift has to be an immediate
+            lowest = _mm_min_epi16(lowest, _mm_srli_si128(lowest, 8));
+            highest = _mm_max_epi16(highest, _mm_srli_si128(highest, 8));
+            lowest = _mm_min_epi16(lowest, _mm_srli_si128(lowest, 4));
+            highest = _mm_max_epi16(highest, _mm_srli_si128(highest, 4));
+            lowest = _mm_min_epi16(lowest, _mm_srli_si128(lowest, 2));
+            highest = _mm_max_epi16(highest, _mm_srli_si128(highest, 2));
+            low = uint16_t(_mm_cvtsi128_si32(lowest) ^ 0x8000);
+            high = uint16_t(_mm_cvtsi128_si32(highest) ^ 0x8000);
+        }
+#endif
+        for(;i<count;i++){
+            low = values[i] < low ? values[i] : low;
+            high = values[i] > high ? values[i] : high;
+        }
+    }
+    static void apply(const uint16_t* values, uchar* out, int count, uint16_t low, float gain){
+        int i = 0;
+#if defined(IR_GAIN_SSE2)
+        const __m128i zero = _mm_setzero_si128();
+        const __m128 offset = _mm_set1_ps(float(low));
+        const __m128 factor = _mm_set1_ps(gain);
+        for(;i+8<=count;i+=8){
+            __m128i x = _mm_loadu_si128(reinterpret_cast<const __m128i*>(values + i));
+            __m128 a = _mm_mul_ps(_mm_sub_ps(_mm_cvtepi32_ps(_mm_unpacklo_epi16(x, zero)), offset), factor);
+            __m128 b = _mm_mul_ps(_mm_sub_ps(_mm_cvtepi32_ps(_mm_unpackhi_epi16(x, zero)), offset), factor);
+            __m128i words = _mm_packs_epi32(_mm_cvttps_epi32(a), _mm_cvttps_epi32(b));
+            _mm_storel_epi64(reinterpret_cast<__m128i*>(out + i), _mm_packus_epi16(words, words));
+        }
+#endif
+        for(;i<count;i++){
+            const int value = int((float(values[i]) - float(low))*gain);
+            out[i] = uchar(value < 0 ? 0 : value > 255 ? 255 : value);
+        }
+    }
+    static const char* kernelName(){
+#if defined(IR_GAIN_SSE2)
+        return "SSE2";
+#else
+        return "scalar";
+#endif
+    }
+};
+
+#endif // IR_GAIN_H
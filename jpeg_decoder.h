@@ -0,0 +1,78 @@
+#ifndef JPEG_DECODER_H
+#define JPEG_DECODER_H
+
+#include <QBuffer>
+#include <QByteArray>
+#include <QImage>
+#include <QImageReader>
+
+#include <cstdint>
+#include <cstring>
+
+#if defined(ONI_VIEWER_TURBOJPEG)
+#include <turbojpeg.h>
+#endif
+
+//JPEG color payloads to RGB888, on whichever thread calls it. with CONFIG+=turbojpeg it's libjpeg-turbo's SIMD
+//decoder with one handle per thread, otherwise Qt's own JPEG reader. both decode reduced sizes (1/2, 1/4, 1/8)
+//in the DCT, which skips most of the work rather than scaling the full picture down afterwards
+class JpegDecoder {
+#if defined(ONI_VIEWER_TURBOJPEG)
+    struct handle{
+        tjhandle decompressor = tjInitDecompress();
+        ~handle(){
+            if(decompressor)
+                tjDestroy(decompressor);
+        }
+    };
+#endif
+public:
+    static int reducedSize(int size, int reduction){
+        return (size + reduction - 1)/reduction;
+    }
+    //the largest reduction the DCT can do that still divides divisor
+    static int reductionFor(int divisor){
+        for(int reduction: {8, 4, 2})
+            if(divisor % reduction == 0)
+                return reduction;
+        return 1;
+    }
+    //width and height are the full size, the picture has to have it; target gets reducedSize() of both
+    static bool decode(const uint8_t* data, size_t size, int width, int height, uchar* target, int targetStride, int reduction = 1){
+        const int targetWidth = reducedSize(width, reduction), targetHeight = reducedSize(height, reduction);
+#if defined(ONI_VIEWER_TURBOJPEG)
+        static thread_local handle decoder;
+        int jpegWidth = 0, jpegHeight = 0, subsampling = 0, colorspace = 0;
+        if(!decoder.decompressor ||
+           tjDecompressHeader3(decoder.decompressor, data, (unsigned long)size, &jpegWidth, &jpegHeight, &subsampling, &colorspace) ||
+           jpegWidth != width || jpegHeight != height)
+            return false;
+        return tjDecompress2(decoder.decompressor, data, (unsigned long)size, target, targetWidth, targetStride, targetHeight,
+                             TJPF_RGB, TJFLAG_FASTDCT) == 0;
+#else
+        QByteArray bytes = QByteArray::fromRawData(reinterpret_cast<const char*>(data), int(size));
+        QBuffer device(&bytes);
+        QImageReader reader(&device, "jpg");
+        if(reader.size() != QSize(width, height))
+            return false;
+        if(reduction > 1)
+            reader.setScaledSize(QSize(targetWidth, targetHeight));
+        QImage image = reader.read();
+        if(image.isNull() || image.width() != targetWidth || image.height() != targetHeight)
+            return false;
+        image = image.convertToFormat(QImage::Format_RGB888);
+        for(int row=0;row<targetHeight;row++)
+            std::memcpy(target + size_t(row)*targetStride, image.constScanLine(row), size_t(targetWidth)*3);
+        return true;
+#endif
+    }
+    static const char* backendName(){
+#if defined(ONI_VIEWER_TURBOJPEG)
+        return "libjpeg-turbo";
+#else
+        return "Qt";
+#endif
+    }
+};
+
+#endif // JPEG_DECODER_H
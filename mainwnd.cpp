@@ -18,46 +18,76 @@ void MainWnd::safeSliderValueSet(int value){
     ui->time_slider->blockSignals(false);
 }
 
-//all-in-one
-void MainWnd::initEverything(){
-    if(!deviceWrapper.device)
-        return;
+//a sensor the recording doesn't have is skipped, only one that's there and won't start is an error
+bool MainWnd::createStreams(){
     openni::Status lastStatus = openni::Status::STATUS_OK;
+    auto device = deviceWrapper.device;
+    const bool hasDepth = device->hasSensor(openni::SENSOR_DEPTH), hasColor = device->hasSensor(openni::SENSOR_COLOR);
+    if(!hasDepth && !hasColor){
+        fastAlert("The recording has neither depth nor color");
+        return false;
+    }
     try{
-        lastStatus = deviceWrapper.depthStream->create(*deviceWrapper.device, openni::SENSOR_DEPTH);
+        if(hasDepth)
+            lastStatus = deviceWrapper.depthStream->create(*deviceWrapper.device, openni::SENSOR_DEPTH);
         if(lastStatus != openni::Status::STATUS_OK){
             fastAlert("depthStream was not created: " + enum_name<decltype(lastStatus)>(lastStatus));
-            return;
+            return false;
         }
-        lastStatus = deviceWrapper.depthStream->start();
+        if(hasDepth)
+            lastStatus = deviceWrapper.depthStream->start();
         if(lastStatus != openni::Status::STATUS_OK){
             fastAlert("depthStream didn't start: " + enum_name<decltype(lastStatus)>(lastStatus));
-            return;
+            return false;
         }
     }
     catch(...){
         fastAlert("depthStream failed starting: " + enum_name<decltype(lastStatus)>(lastStatus));
     }
     try {
-        lastStatus = deviceWrapper.device->setImageRegistrationMode(openni::IMAGE_REGISTRATION_DEPTH_TO_COLOR);
+        if(hasDepth && hasColor)
+            lastStatus = deviceWrapper.device->setImageRegistrationMode(openni::IMAGE_REGISTRATION_DEPTH_TO_COLOR);
         if(lastStatus != openni::Status::STATUS_OK){
             fastAlert("colorStream setImageRegistrationMode: " + enum_name<decltype(lastStatus)>(lastStatus));
-            return;
+            return false;
         }
-        lastStatus = deviceWrapper.colorStream->create(*deviceWrapper.device, openni::SENSOR_COLOR);
+        if(hasColor)
+            lastStatus = deviceWrapper.colorStream->create(*deviceWrapper.device, openni::SENSOR_COLOR);
         if(lastStatus != openni::Status::STATUS_OK){
             fastAlert("colorStream was not created: " + enum_name<decltype(lastStatus)>(lastStatus));
-            return;
+            return false;
         }
-        lastStatus = deviceWrapper.colorStream->start();
+        if(hasColor)
+            lastStatus = deviceWrapper.colorStream->start();
         if(lastStatus != openni::Status::STATUS_OK){
             fastAlert("colorStream didn't start: " + enum_name<decltype(lastStatus)>(lastStatus));
-            return;
+            return false;
         }
     }
     catch (...) {
         fastAlert("colorStream failed starting: " + enum_name<decltype(lastStatus)>(lastStatus));
     }
+    //IR is an extra, the file still plays without it
+    try {
+        if(device->hasSensor(openni::SENSOR_IR) &&
+           (deviceWrapper.irStream->create(*device, openni::SENSOR_IR) != openni::STATUS_OK || deviceWrapper.irStream->start() != openni::STATUS_OK))
+            deviceWrapper.irStream->destroy();
+    }
+    catch (...) {
+        deviceWrapper.irStream->destroy();
+    }
+    return true;
+}
+
+//all-in-one
+void MainWnd::initEverything(){
+    //without a device only the native reader is left, it doesn't need OpenNI streams
+    if(!deviceWrapper.device && !deviceWrapper.servesNatively())
+        return;
+    if(deviceWrapper.device && !createStreams())
+        return;
+    irVideo->setVisible(deviceWrapper.hasIr() && ui->actionIrView->isChecked());
+    updateDisplayDivisors();//before the first frame is converted
 
     // here i could seek through videostream, caching frames on a fly etc. Yet, it was not really possible
     std::thread th([this](){
@@ -88,22 +118,30 @@ void MainWnd::initEverything(){
 
                     safeSliderValueSet(0);
                     ui->time_slider->setMaximum(deviceWrapper.lastReadyFrame);
+                    thumbnails.start(openedFile);
+                    double horizontalFov, verticalFov;
+                    deviceWrapper.depthFieldOfView(horizontalFov, verticalFov);
+                    cloudView->setFieldOfView(horizontalFov, verticalFov);
+                    repeater->setPeriod(deviceWrapper.framePeriod());
+                    repeater->resetStats();
+                    droppedFrames = 0;
                     restartPlaybackFromPos(0);
 
                     setEnabledUi(true);
                 }
             }
             else{
-                ui->left_label->setText("Loading... "+QString::number(float_t(deviceWrapper.lastReadyFrame*100)/deviceWrapper.depthPixmaps.size())+"%");
+                ui->left_label->setText("Loading... "+QString::number(float_t(deviceWrapper.lastReadyFrame*100)/deviceWrapper.depthFrames.size())+"%");
                 return;
             }
 
             auto now = std::chrono::steady_clock::now();
-            auto timeSincePlaybackStart = std::chrono::duration_cast<std::chrono::milliseconds>(now - playbackStartTime->first).count();
+            auto timeSincePlaybackStart = std::chrono::duration_cast<std::chrono::microseconds>(now - playbackStartTime->first).count();
             int64_t frameNo = 0;
 
+            //wall time runs along the recorded timestamps, so gaps and rate changes play back as they were recorded
             if(playbackEnabled)
-                nextFrame = (frameNo = (timeSincePlaybackStart*deviceWrapper.FPS)/1000 + playbackStartTime->second);
+                nextFrame = (frameNo = deviceWrapper.tickAt(deviceWrapper.tickTime(playbackStartTime->second) + uint64_t(timeSincePlaybackStart)));
             else
                 frameNo = nextFrame;
 
@@ -112,59 +150,238 @@ void MainWnd::initEverything(){
                 return;
             }
 
-            if(playbackEnabled && frameNo > deviceWrapper.lastReadyFrame){
+            if(playbackEnabled && frameNo >= deviceWrapper.lastReadyFrame){
                 frameNo = deviceWrapper.lastReadyFrame;
                 playbackEnabled = false;
             }
 
+            //the tick follows the stream's rate, still the same frame can come up twice around a late tick
+            if(playbackEnabled && frameNo == requestedFrame)
+                return;
+            if(playbackEnabled && currentFrame >= playbackStartTime->second && frameNo > currentFrame + 1)
+                droppedFrames += frameNo - currentFrame - 1;
+
             currentFrame = frameNo;
-            ui->right_label->setText(buildTimeString(currentFrame/deviceWrapper.FPS)+QString(" (F%1)").arg(currentFrame));
+            QString timeText = buildTimeString(int64_t(deviceWrapper.tickTime(currentFrame)/1000))+QString(" (F%1)").arg(currentFrame);
+            //late: the tick came too late or the frame wasn't decoded ahead
+            auto lateFrames = repeater->late() + prefetcher.misses();
+            if(droppedFrames || lateFrames)
+                timeText += QString(" dropped %1, late %2").arg(qulonglong(droppedFrames)).arg(qulonglong(lateFrames));
+            ui->right_label->setText(timeText);
 
             float_t framePos = float_t(frameNo)/deviceWrapper.lastReadyFrame;
             safeSliderValueSet(framePos*ui->time_slider->maximum());
 
-            setFrameByPosition(framePos);
+            showFrame(frameNo);
         },33);
     }
 }
 
-QString MainWnd::buildTimeString(int64_t seconds){
+//hh:mm:ss.mmm
+QString MainWnd::buildTimeString(int64_t milliseconds){
     QString empty = "", zero = "0";
+    auto ms = milliseconds%1000;
+    auto seconds = milliseconds/1000;
     auto sec = seconds%60;
     auto min = (seconds%3600)/60;
     auto hr = seconds/3600;
     return (((hr<=9?zero:empty))+QString::number(hr)+":"+
             ((min<=9?zero:empty))+QString::number(min)+":"+
-            ((sec<=9?zero:empty))+QString::number(sec));
+            ((sec<=9?zero:empty))+QString::number(sec)+"."+
+            ((ms<=99?zero:empty))+((ms<=9?zero:empty))+QString::number(ms));
+}
+
+//[[hh:]mm:]ss[.mmm], each field may run over, 90 seconds is fine
+bool MainWnd::parseTimeString(const QString& text, int64_t& milliseconds){
+    double seconds = 0;
+    int fields = 0;
+    for(auto& field: text.trimmed().split(":")){
+        bool ok = false;
+        double value = field.toDouble(&ok);
+        if(!ok || value < 0 || ++fields > 3)
+            return false;
+        seconds = seconds*60 + value;
+    }
+    milliseconds = int64_t(seconds*1000 + 0.5);
+    return fields > 0;
 }
 
 void MainWnd::restartPlaybackFromPos(float_t pos){
-    playbackStartTime->second = deviceWrapper.lastReadyFrame*pos;
-    playbackStartTime->first = std::chrono::steady_clock::now();
-    playbackEnabled = true;
+    restartPlaybackFromFrame(int64_t(deviceWrapper.lastReadyFrame*pos));
 }
 
 void MainWnd::restartPlaybackFromFrame(int64_t frame){
-    restartPlaybackFromPos(float_t(frame)/deviceWrapper.lastReadyFrame);
+    playbackStartTime->second = frame;
+    playbackStartTime->first = std::chrono::steady_clock::now();
+    playbackEnabled = true;
 }
 
 void MainWnd::setFrameByPosition(float_t pos){
-    auto destFrame = size_t(deviceWrapper.lastReadyFrame*pos);
-
-    leftScene->removeItem(previousLeftPixmap);
-    rightScene->removeItem(previousRightPixmap);
+    showFrame(int64_t(deviceWrapper.lastReadyFrame*pos));
+}
 
-    leftScene->addItem(previousLeftPixmap = deviceWrapper.colorPixmaps[destFrame]);
-    rightScene->addItem(previousRightPixmap = deviceWrapper.depthPixmaps[destFrame]);
+//the frame shows up once it's decoded, unless something newer was asked for in the meantime;
+//during playback it's normally decoded already by the prefetcher
+void MainWnd::showFrame(int64_t frameNo){
+    requestedFrame = frameNo;
+    prefetcher.update(frameNo, playbackEnabled);
+    decodedFrame prefetched;
+    if(prefetcher.lookup(frameNo, prefetched)){
+        presentFrame(frameNo, prefetched);
+        return;
+    }
+    //a thumbnail right away while scrubbing, the full frame replaces it once decoded
+    ThumbnailTrack::thumbnail thumbnail;
+    if(!deviceWrapper.frameCache.contains(frameNo) && thumbnails.lookup(frameNo, thumbnail))
+        presentFrame(frameNo, thumbnail.frame);
+    frameProvider.requestFrame(frameNo, [this](size_t index, const decodedFrame& frame){
+        if(QThread::currentThread() == thread())
+            presentFrame(index, frame);
+        else
+            QMetaObject::invokeMethod(this, [this, index, frame](){ presentFrame(index, frame); }, Qt::QueuedConnection);
+    });
+}
 
-    ui->left_gview->fitInView(previousLeftPixmap,Qt::KeepAspectRatio);
-    ui->right_gview->fitInView(previousRightPixmap,Qt::KeepAspectRatio);
+void MainWnd::presentFrame(int64_t frameNo, const decodedFrame& stored){
+    if(frameNo != requestedFrame || !stored.isValid())
+        return;//stale or failed, keep showing the previous frame
 
+    QElapsedTimer presentTimer;
+    presentTimer.start();
+    //compressed depth is decoded once here, the views below all take the same pixels
+    decodedFrame frame = stored;
+    frame.depth = stored.depth.decompressed();
     if(firstRun){
         firstRun = false;
         ui->left_gview->setScene(leftScene);
         ui->right_gview->setScene(rightScene);
     }
+    //against the earlier frame as it's cached, it's normally still there from when it was shown itself.
+    //if it isn't, the frame goes up plain and the worker decodes the earlier one, never the GUI thread
+    decodedFrame difference;
+    bool differencing = false;
+    if(deviceWrapper.showDifference && frameNo >= deviceWrapper.differenceStride){
+        QElapsedTimer differenceTimer;
+        differenceTimer.start();
+        const int64_t earlierNo = frameNo - deviceWrapper.differenceStride;
+        decodedFrame earlier;
+        if(auto cached = deviceWrapper.frameCache.get(earlierNo))
+            earlier = *cached;
+        else
+            frameProvider.requestFrame(size_t(earlierNo), [this, frameNo](size_t, const decodedFrame& decoded){
+                if(decoded.isValid())
+                    QMetaObject::invokeMethod(this, [this, frameNo](){
+                        if(frameNo == requestedFrame)
+                            showFrame(frameNo);
+                    }, Qt::QueuedConnection);
+            }, false);
+        differencing = earlier.isValid() && deviceWrapper.differenceFrame(frame, earlier, difference);
+        if(differencing){
+            differenceNanoseconds += differenceTimer.nsecsElapsed();
+            differenceCount++;
+        }
+    }
+    const frameBuffer& colorView = differencing ? difference.color : frame.color;
+    //the overlay takes the depth view's place, color stays on its own next to it
+    frameBuffer depthView;
+    if(differencing)
+        depthView = deviceWrapper.colorizeDifference(difference.depth);
+    else if(deviceWrapper.overlayDepth)
+        depthView = deviceWrapper.overlayDepthOnColor(frame.color, frame.depth);
+    else
+        depthView = deviceWrapper.colorizeDepth(frame.depth);
+    //the items and widgets hold on to the buffers, so the cache is free to drop the frame right after this
+    double paintMs = 0;
+    if(directBlit){
+        leftVideo->setFrame(colorView);
+        rightVideo->setFrame(depthView);
+        paintMs = leftVideo->averagePaintMs() + rightVideo->averagePaintMs();
+    }
+    else{
+        bool leftResized = leftDisplay->setFrame(colorView);
+        bool rightResized = rightDisplay->setFrame(depthView);
+        if(leftResized)
+            ui->left_gview->fitInView(leftDisplay,Qt::KeepAspectRatio);
+        if(rightResized)
+            ui->right_gview->fitInView(rightDisplay,Qt::KeepAspectRatio);
+        paintMs = leftDisplay->averagePaintMs() + rightDisplay->averagePaintMs();
+    }
+    if(cloudView->isVisible())
+        cloudView->setFrame(frame.depth, depthView);
+    //thumbnails have no IR, the last full frame's stays up while scrubbing
+    if(irVideo->isVisible()){
+        if(frame.ir.isValid())
+            irVideo->setFrame(deviceWrapper.gainIr(frame.ir));
+        else if(!deviceWrapper.hasIrFrame(frameNo))
+            irVideo->clear();
+    }
+    presentNanoseconds += presentTimer.nsecsElapsed();
+    presentCount++;
+
+    //painting happens later in the event loop, it's measured by the items and widgets themselves
+    QString status = QString("%1: present %2 ms, paint %3 ms")
+            .arg(directBlit ? "Direct" : "Scene")
+            .arg(presentNanoseconds/1e6/presentCount,0,'f',2)
+            .arg(paintMs,0,'f',2);
+    status += QString(" | colormap %1 GB/s (%2)").arg(deviceWrapper.depthColormap.gigabytesPerSecond(),0,'f',2)
+            .arg(DepthColormap::kernelName());
+    if(thumbnails.progress() < 1.)
+        status += QString(" | thumbnails %1%").arg(int(thumbnails.progress()*100));
+    if(deviceWrapper.autoDepthRange || deviceWrapper.equalizeDepth)
+        status += QString(", %1-%2 mm").arg(int(deviceWrapper.depthColormap.nearDepth())).arg(int(deviceWrapper.depthColormap.farDepth()));
+    if(differencing)
+        status += QString(" | difference -%1 (%2), %3 ms").arg(deviceWrapper.differenceStride).arg(FrameDiff::kernelName())
+                .arg(differenceNanoseconds/1e6/differenceCount,0,'f',2);
+    if(cloudView->isVisible())
+        status += QString(" | cloud %1 ms").arg(cloudView->averageRenderMs(),0,'f',2);
+    if(irVideo->isVisible() && frame.ir.format == QImage::Format_Grayscale16)
+        status += QString(" | IR %1-%2 (%3)").arg(int(deviceWrapper.irLow)).arg(int(deviceWrapper.irHigh)).arg(IrGain::kernelName());
+    if(deviceWrapper.overlayDepth)
+        status += QString(" | overlay %1% (%2)").arg(int(deviceWrapper.overlayAlpha*100/256)).arg(OverlayBlend::kernelName());
+    if(deviceWrapper.colorDivisor > 1 || deviceWrapper.depthDivisor > 1)
+        status += QString(" | decoded at 1/%1, 1/%2").arg(int(deviceWrapper.colorDivisor)).arg(int(deviceWrapper.depthDivisor));
+    if(deviceWrapper.decodesJpegColor())
+        status += QString(" | JPEG color (%1)").arg(JpegDecoder::backendName());
+    if(stored.depth.compressed){
+        auto& stats = *stored.depth.stats;
+        status += QString(" | depth x%1, decode %2 ms").arg(stats.ratio(),0,'f',2).arg(stats.averageDecodeMs(),0,'f',2);
+    }
+    ui->left_label->setText(status);
+}
+
+//the views are only fitted again when their frame size changes, or when they are resized themselves
+bool MainWnd::eventFilter(QObject* watched, QEvent* event){
+    if(event->type() == QEvent::Resize){
+        if(watched == ui->left_gview)
+            ui->left_gview->fitInView(leftDisplay,Qt::KeepAspectRatio);
+        else if(watched == ui->right_gview)
+            ui->right_gview->fitInView(rightDisplay,Qt::KeepAspectRatio);
+        updateDisplayDivisors();
+    }
+    return QMainWindow::eventFilter(watched, event);
+}
+
+//frames are converted at the size they're shown at, rounded up to a whole factor of the recorded size.
+//only a change of the factor drops the cached frames, resizing within one step keeps them
+void MainWnd::updateDisplayDivisors(){
+    int colorDivisor = 1, depthDivisor = 1, irDivisor = 1;
+    if(decodeAtViewSize){
+        auto physicalSize = [](QWidget* view){
+            const qreal ratio = view->devicePixelRatioF();
+            return QSize(int(view->width()*ratio), int(view->height()*ratio));
+        };
+        QWidget* leftView = directBlit ? static_cast<QWidget*>(leftVideo) : ui->left_gview->viewport();
+        QWidget* rightView = directBlit ? static_cast<QWidget*>(rightVideo) : ui->right_gview->viewport();
+        colorDivisor = deviceVStreamInfo::divisorFor(deviceWrapper.sourceSize(false), physicalSize(leftView));
+        depthDivisor = deviceVStreamInfo::divisorFor(deviceWrapper.sourceSize(true), physicalSize(rightView));
+        if(irVideo->isVisible())
+            irDivisor = deviceVStreamInfo::divisorFor(deviceWrapper.irSourceSize(), physicalSize(irVideo));
+    }
+    if(!deviceWrapper.setDisplayDivisors(colorDivisor, depthDivisor, irDivisor))
+        return;
+    prefetcher.reset();
+    resetRenderStats();
+    refreshFrame();
 }
 
 void MainWnd::Play(){
@@ -195,29 +412,50 @@ void MainWnd::LastFrame(){
     if(playbackEnabled)
         restartPlaybackFromPos(1);
     else
-        nextFrame = deviceWrapper.lastReadyFrame;
+        showFrame(nextFrame = deviceWrapper.lastReadyFrame);
+}
+
+//the tick showing at that time, found through the same timestamps playback runs on
+void MainWnd::SeekToTime(){
+    if(!deviceWrapper.readyForUsage)
+        return;
+    bool ok = false;
+    QString text = QInputDialog::getText(this, tr("Go to time"), tr("Time from the start (hh:mm:ss.mmm):"), QLineEdit::Normal,
+                                         buildTimeString(int64_t(deviceWrapper.tickTime(currentFrame)/1000)), &ok);
+    if(!ok)
+        return;
+    int64_t milliseconds = 0;
+    if(!parseTimeString(text, milliseconds)){
+        fastAlert("Time should look like hh:mm:ss.mmm");
+        return;
+    }
+    const int64_t frame = deviceWrapper.tickAt(uint64_t(milliseconds)*1000);
+    if(playbackEnabled)
+        restartPlaybackFromFrame(frame);
+    else
+        nextFrame = frame;
 }
 
 void MainWnd::SliderMove(int value){
     if(playbackEnabled)
         restartPlaybackFromPos(float_t(value)/ui->time_slider->maximum());
     nextFrame = (value*deviceWrapper.lastReadyFrame)/ui->time_slider->maximum();
+    if(!playbackEnabled)
+        showFrame(nextFrame);
 }
 
 void MainWnd::reinititialiseComponents(){
     setEnabledUi(false);
     *playbackStartTime = {std::chrono::steady_clock::now(),0};
 
-    auto leftSceneItems = leftScene->items();
-    auto rightSceneItems = rightScene->items();
-
-    for(auto& i: leftSceneItems)
-        leftScene->removeItem(i);
-    for(auto& i: rightSceneItems)
-        rightScene->removeItem(i);
-
-    previousLeftPixmap = nullptr;
-    previousRightPixmap = nullptr;
+    leftDisplay->clear();
+    rightDisplay->clear();
+    leftVideo->clear();
+    rightVideo->clear();
+    cloudView->clear();
+    irVideo->clear();
+    resetRenderStats();
+    requestedFrame = -1;
 }
 
 void MainWnd::openFile() {
@@ -239,14 +477,24 @@ void MainWnd::openFile() {
         auto devicePtr = new openni::Device();
         auto openStatus = devicePtr->open(filename.constData());
         if(openStatus!=openni::STATUS_OK){
-            fastAlert("Device failed to open: " + enum_name<openni::Status>(openStatus));
             delete devicePtr;
-            return;
+            devicePtr = nullptr;
+            //uncompressed recordings are still playable without OpenNI
+            OniFileReader probe;
+            if(!OniFileReader::isPlayable(probe.open(firstFile)) || !deviceVStreamInfo::isNativelyPlayable(probe)){
+                fastAlert("Device failed to open: " + enum_name<openni::Status>(openStatus));
+                return;
+            }
         }
         reinititialiseComponents();
+        frameProvider.cancelPending();
+        prefetcher.reset();
+        thumbnails.stop();
+        openedFile = firstFile;
         deviceWrapper.clearAll();
+        deviceWrapper.openNative(firstFile);
         deviceWrapper.device = devicePtr;
-        deviceWrapper.playbackControl = deviceWrapper.device->getPlaybackControl();
+        deviceWrapper.playbackControl = devicePtr ? devicePtr->getPlaybackControl() : nullptr;
         initEverything();
     }
     else{
@@ -254,6 +502,288 @@ void MainWnd::openFile() {
     }
 }
 
+void MainWnd::SetCacheBudget(){
+    bool ok = false;
+    int budgetMB = QInputDialog::getInt(this, tr("Frame cache"), tr("Cache budget (MB):"),
+                                        int(deviceWrapper.frameCache.budget()>>20), 64, 1<<20, 64, &ok);
+    if(ok)
+        deviceWrapper.frameCache.setBudget(size_t(budgetMB)<<20);
+}
+
+void MainWnd::SetConversionThreads(){
+    bool ok = false;
+    int threads = QInputDialog::getInt(this, tr("Frame conversion"), tr("Conversion threads:"),
+                                       int(deviceWrapper.conversionPool.threadCount()), 1, 256, 1, &ok);
+    if(ok)
+        deviceWrapper.conversionPool.setThreadCount(threads);
+}
+
+void MainWnd::SetMemoryMapping(bool enabled){
+    deviceWrapper.useMemoryMapping = enabled;//takes effect with the next opened file
+}
+
+void MainWnd::SetThumbnailPersistence(bool enabled){
+    thumbnails.persist = enabled;//takes effect with the next opened file
+}
+
+void MainWnd::SetDepthCompression(bool enabled){
+    deviceWrapper.compressDepth = enabled;//frames already in the cache stay as they are
+}
+
+void MainWnd::SetPrefetchDepth(){
+    bool ok = false;
+    int depth = QInputDialog::getInt(this, tr("Playback prefetch"), tr("Frames decoded ahead:"),
+                                     int(prefetcher.depth()), 1, 1024, 1, &ok);
+    if(ok)
+        prefetcher.setDepth(depth);
+}
+
+//the scene views and the direct widgets share the grid cells, only one pair is visible at a time
+void MainWnd::SetDirectBlit(bool enabled){
+    directBlit = enabled;
+    ui->left_gview->setVisible(!enabled);
+    ui->right_gview->setVisible(!enabled);
+    leftVideo->setVisible(enabled);
+    rightVideo->setVisible(enabled);
+    resetRenderStats();
+    if(enabled){
+        leftDisplay->clear();
+        rightDisplay->clear();
+    }
+    else{
+        leftVideo->clear();
+        rightVideo->clear();
+    }
+    updateDisplayDivisors();
+    refreshFrame();//the newly shown pair has nothing yet
+}
+
+void MainWnd::SetDecodeAtViewSize(bool enabled){
+    decodeAtViewSize = enabled;
+    updateDisplayDivisors();
+}
+
+void MainWnd::SetDepthPalette(QAction* action){
+    if(action == ui->actionPaletteTurbo)
+        deviceWrapper.depthColormap.setPalette(DepthColormap::Palette::TURBO);
+    else if(action == ui->actionPaletteJet)
+        deviceWrapper.depthColormap.setPalette(DepthColormap::Palette::JET);
+    else
+        deviceWrapper.depthColormap.setPalette(DepthColormap::Palette::GRAYSCALE);
+    refreshFrame();
+}
+
+void MainWnd::SetDepthRange(){
+    auto& colormap = deviceWrapper.depthColormap;
+    bool ok = false;
+    int nearDepth = QInputDialog::getInt(this, tr("Depth range"), tr("Near clipping (mm):"),
+                                         colormap.nearDepth(), 0, 65534, 50, &ok);
+    if(!ok)
+        return;
+    int farDepth = QInputDialog::getInt(this, tr("Depth range"), tr("Far clipping (mm):"),
+                                        colormap.farDepth(), nearDepth + 1, 65535, 50, &ok);
+    if(!ok)
+        return;
+    colormap.setRange(uint16_t(nearDepth), uint16_t(farDepth));
+    ui->actionAutoDepthRange->setChecked(false);//a range picked by hand wins
+    refreshFrame();
+}
+
+void MainWnd::SetAutoDepthRange(bool enabled){
+    deviceWrapper.autoDepthRange = enabled;
+    deviceWrapper.depthHistogram.reset();
+    refreshFrame();
+}
+
+void MainWnd::SetDepthEqualization(bool enabled){
+    deviceWrapper.equalizeDepth = enabled;
+    deviceWrapper.depthHistogram.reset();
+    if(!enabled)
+        deviceWrapper.depthColormap.clearEqualization();
+    refreshFrame();
+}
+
+void MainWnd::SetDepthOverlay(bool enabled){
+    deviceWrapper.overlayDepth = enabled;
+    refreshFrame();
+}
+
+void MainWnd::SetOverlayOpacity(){
+    bool ok = false;
+    int opacity = QInputDialog::getInt(this, tr("Depth overlay"), tr("Depth opacity (%):"),
+                                       int(deviceWrapper.overlayAlpha*100/256), 0, 100, 5, &ok);
+    if(!ok)
+        return;
+    deviceWrapper.overlayAlpha = uint32_t(opacity*256/100);
+    refreshFrame();
+}
+
+//points take the depth view's colors: the colormap, or the color frame with the overlay on
+void MainWnd::SetPointCloudView(bool enabled){
+    cloudView->setVisible(enabled);
+    if(!enabled)
+        cloudView->clear();
+    refreshFrame();
+}
+
+//IR is only decoded while it's shown, switching drops the cached frames
+void MainWnd::SetIrView(bool enabled){
+    deviceWrapper.setDecodeIr(enabled);
+    irVideo->setVisible(enabled && deviceWrapper.hasIr());
+    if(!enabled)
+        irVideo->clear();
+    prefetcher.reset();
+    updateDisplayDivisors();
+    refreshFrame();
+}
+
+void MainWnd::SetFrameDifference(bool enabled){
+    deviceWrapper.showDifference = enabled;
+    refreshFrame();
+}
+
+void MainWnd::SetDifferenceOptions(){
+    bool ok = false;
+    int stride = QInputDialog::getInt(this, tr("Frame difference"), tr("Compare with the frame this many frames back:"),
+                                      deviceWrapper.differenceStride, 1, 1000, 1, &ok);
+    if(!ok)
+        return;
+    int range = QInputDialog::getInt(this, tr("Frame difference"), tr("Depth difference at full scale (mm):"),
+                                     deviceWrapper.differenceRange(), 1, 65534, 10, &ok);
+    if(!ok)
+        return;
+    deviceWrapper.differenceStride = stride;
+    deviceWrapper.setDifferenceRange(uint16_t(range));
+    refreshFrame();
+}
+
+//0 goes back to half the reference stream's frame period
+void MainWnd::SetSyncTolerance(){
+    bool ok = false;
+    double tolerance = QInputDialog::getDouble(this, tr("Stream sync tolerance"),
+                                               tr("Show a frame up to this far from the tick, 0 for half a frame (ms):"),
+                                               deviceWrapper.sync.tolerance()/1000., 0, 10000, 1, &ok);
+    if(!ok)
+        return;
+    deviceWrapper.setSyncTolerance(uint64_t(tolerance*1000));
+    prefetcher.reset();
+    refreshFrame();
+}
+
+void MainWnd::SetInvalidDepthColor(){
+    QColor color = QColorDialog::getColor(QColor::fromRgba(deviceWrapper.depthColormap.invalidColor()), this, tr("Invalid depth color"));
+    if(!color.isValid())
+        return;
+    deviceWrapper.depthColormap.setInvalidColor(color.rgba());
+    refreshFrame();
+}
+
+//playback pauses, and the cache warm-up has to be done, so the numbers aren't shared with anything else.
+//a long recording takes a while, so it runs on a thread of its own and the result comes back queued
+void MainWnd::BenchmarkDecoding(){
+    if(!deviceWrapper.readyForUsage)
+        return;
+    Pause();
+    ui->actionBenchmarkDecoding->setEnabled(false);
+    ui->left_label->setText("Benchmarking depth decoding...");
+    std::thread th([this](){
+        //the lock is taken and released on this thread, loading a file can't start in between
+        if(!deviceWrapper.fileProcessing.try_lock()){
+            QMetaObject::invokeMethod(this, [this](){
+                ui->actionBenchmarkDecoding->setEnabled(true);
+                fastAlert("File is in the process of loading...");
+            }, Qt::QueuedConnection);
+            return;
+        }
+        auto measured = DecodeBenchmark::run(deviceWrapper, 300);
+        deviceWrapper.fileProcessing.unlock();
+        QMetaObject::invokeMethod(this, [this, measured](){ showDecodingBenchmark(measured); }, Qt::QueuedConnection);
+    });
+    th.detach();
+}
+
+void MainWnd::showDecodingBenchmark(const DecodeBenchmark::result& measured){
+    ui->actionBenchmarkDecoding->setEnabled(true);
+    if(!measured.frames){
+        fastAlert("Depth of this file isn't read natively, there's nothing to compare");
+        return;
+    }
+    const uint32_t codec = deviceWrapper.nativeDepth->codec;
+    QString codecName = codec == OniFileReader::CODEC_16Z ? "16z" : codec == OniFileReader::CODEC_16Z_EMB_TABLES ? "16zT" : "uncompressed";
+    QString text = QString("%1 depth, %2 frames\n").arg(codecName).arg(qulonglong(measured.frames));
+    text += QString("native, 1 thread: %1 ms/frame, %2 fps\n").arg(measured.nativeSingleMs/measured.frames,0,'f',3)
+            .arg(measured.framesPerSecond(measured.nativeSingleMs, measured.frames),0,'f',0);
+    text += QString("native, %1 threads: %2 ms/frame, %3 fps\n").arg(qulonglong(measured.threads))
+            .arg(measured.nativePoolMs/measured.frames,0,'f',3).arg(measured.framesPerSecond(measured.nativePoolMs, measured.frames),0,'f',0);
+    if(measured.openniFrames)
+        text += QString("OpenNI: %1 ms/frame, %2 fps").arg(measured.openniMs/measured.openniFrames,0,'f',3)
+                .arg(measured.framesPerSecond(measured.openniMs, measured.openniFrames),0,'f',0);
+    else
+        text += "OpenNI: not available for this file";
+    if(measured.failed)
+        text += "\nsome frames failed to decode natively";
+    QMessageBox::information(this, tr("Depth decoding"), text);
+}
+
+//one frame of the recording's color size, or VGA without a recording, through every format's kernel
+void MainWnd::BenchmarkPixelFormats(){
+    QSize size = deviceWrapper.sourceSize(false);
+    if(size.isEmpty())
+        size = QSize(640, 480);
+    auto results = DecodeBenchmark::runFormats(size.width(), size.height(), 100);
+    QString text = QString("%1x%2, %3 kernels\n").arg(size.width()).arg(size.height()).arg(PixelConverter::kernelName());
+    for(auto& measured: results)
+        text += QString("%1%2: %3 ms/frame, %4 Mpx/s\n").arg(measured.name).arg(measured.converted ? "" : " (copy)")
+                .arg(measured.msPerFrame,0,'f',3).arg(measured.megapixelsPerSecond,0,'f',0);
+    QMessageBox::information(this, tr("Pixel format conversion"), text.trimmed());
+}
+
+//how far each stream is from the ticks it's shown at, against what pairing by read order had
+void MainWnd::ShowSyncReport(){
+    if(!deviceWrapper.readyForUsage)
+        return;
+    auto& sync = deviceWrapper.sync;
+    if(!sync.isTimed()){
+        fastAlert("This file's timestamps aren't known, its streams are paired by frame order");
+        return;
+    }
+    const char* names[] = {"depth", "color", "IR"};
+    QString text = QString("%1 ticks from %2, tolerance %3 ms\n").arg(qulonglong(sync.ticks()))
+            .arg(names[sync.referenceStream()]).arg(sync.tolerance()/1000.,0,'f',1);
+    for(int stream=0;stream<StreamSync::STREAM_COUNT;stream++){
+        auto stats = sync.drift(StreamSync::Stream(stream));
+        if(!stats.frames)
+            continue;
+        text += QString("\n%1: %2 frames, %3 dropped\n").arg(names[stream]).arg(qulonglong(stats.frames)).arg(qulonglong(stats.dropped));
+        if(stream == sync.referenceStream())
+            continue;
+        text += QString("shown at %1 ticks, missing at %2\n").arg(qulonglong(stats.matched)).arg(qulonglong(stats.unmatched));
+        text += QString("offset mean %1 ms, max %2 ms\n").arg(stats.meanOffsetMs,0,'f',2).arg(stats.maxOffsetMs,0,'f',2);
+        text += QString("pairing by order would be off by up to %1 ms\n").arg(stats.indexPairingMs,0,'f',1);
+    }
+    QMessageBox::information(this, tr("Stream synchronization"), text.trimmed());
+}
+
+//shows the current frame again, after a display setting changed
+void MainWnd::refreshFrame(){
+    if(requestedFrame >= 0)
+        showFrame(requestedFrame);
+}
+
+void MainWnd::resetRenderStats(){
+    leftDisplay->resetStats();
+    rightDisplay->resetStats();
+    leftVideo->resetStats();
+    rightVideo->resetStats();
+    cloudView->resetStats();
+    irVideo->resetStats();
+    deviceWrapper.depthColormap.resetStats();
+    presentNanoseconds = 0;
+    presentCount = 0;
+    differenceNanoseconds = 0;
+    differenceCount = 0;
+}
+
 void MainWnd::setEnabledUi(bool enable){
     ui->center->setEnabled(enable);
     ui->butt_frame->setEnabled(enable);
@@ -273,16 +803,49 @@ MainWnd::MainWnd(QWidget *parent) :
     repeater(nullptr),
     leftScene(new QGraphicsScene(this)),
     rightScene(new QGraphicsScene(this)),
+    leftDisplay(new FrameSurfaceItem),
+    rightDisplay(new FrameSurfaceItem),
+    leftVideo(nullptr),
+    rightVideo(nullptr),
+    cloudView(nullptr),
+    irVideo(nullptr),
     ui(new Ui::MainWnd),
     msgBox(new QMessageBox(this)),
-    previousLeftPixmap(nullptr),
-    previousRightPixmap(nullptr),
+    frameProvider(deviceWrapper),
+    prefetcher(deviceWrapper),
+    thumbnails(deviceWrapper),
     playbackStartTime(new time_frame_pair({std::chrono::steady_clock::now(),0})),
-    currentFrame(0), nextFrame(0),
-    playbackEnabled(false), firstRun(true) {
+    requestedFrame(-1),
+    currentFrame(0), nextFrame(0), droppedFrames(0),
+    presentNanoseconds(0), presentCount(0), differenceNanoseconds(0), differenceCount(0),
+    playbackEnabled(false), firstRun(true), directBlit(false), decodeAtViewSize(true) {
 
     ui->setupUi(this);
     msgBox->setIcon(QMessageBox::Warning);
+    //one item per view for the whole session, frames only swap its pixmap
+    //a single item per scene, there's nothing for an index to speed up
+    leftScene->setItemIndexMethod(QGraphicsScene::NoIndex);
+    rightScene->setItemIndexMethod(QGraphicsScene::NoIndex);
+    leftScene->addItem(leftDisplay);
+    rightScene->addItem(rightDisplay);
+    ui->left_gview->installEventFilter(this);
+    ui->right_gview->installEventFilter(this);
+    leftVideo = new VideoWidget(ui->center);
+    rightVideo = new VideoWidget(ui->center);
+    ui->grid->addWidget(leftVideo, 0, 0);
+    ui->grid->addWidget(rightVideo, 0, 1);
+    leftVideo->setVisible(false);
+    rightVideo->setVisible(false);
+    leftVideo->installEventFilter(this);
+    rightVideo->installEventFilter(this);
+    cloudView = new PointCloudWidget(ui->center);
+    ui->grid->addWidget(cloudView, 0, 2);
+    cloudView->setVisible(false);
+    //a plain widget in either mode, it only shows up for recordings with IR
+    irVideo = new VideoWidget(ui->center);
+    ui->grid->addWidget(irVideo, 0, 3);
+    irVideo->setVisible(false);
+    irVideo->installEventFilter(this);
     setEnabledUi(false);
 
     auto openFileButtStatus = connect(ui->actionOpen,SIGNAL(triggered()), this,SLOT(openFile()));
@@ -293,6 +856,34 @@ MainWnd::MainWnd(QWidget *parent) :
     auto firstFrameButtStatus = connect(ui->first_frame,SIGNAL(clicked()),this, SLOT(FirstFrame()));
     auto lastFrameButtStatus = connect(ui->last_frame,SIGNAL(clicked()),this, SLOT(LastFrame()));
     auto sliderMoveStatus = connect(ui->time_slider,SIGNAL(valueChanged(int)),this,SLOT(SliderMove(int)));
+    auto cacheBudgetStatus = connect(ui->actionCacheBudget,SIGNAL(triggered()),this,SLOT(SetCacheBudget()));
+    auto conversionThreadsStatus = connect(ui->actionConversionThreads,SIGNAL(triggered()),this,SLOT(SetConversionThreads()));
+    auto memoryMappingStatus = connect(ui->actionMemoryMapping,SIGNAL(toggled(bool)),this,SLOT(SetMemoryMapping(bool)));
+    auto depthCompressionStatus = connect(ui->actionCompressDepth,SIGNAL(toggled(bool)),this,SLOT(SetDepthCompression(bool)));
+    auto prefetchDepthStatus = connect(ui->actionPrefetchDepth,SIGNAL(triggered()),this,SLOT(SetPrefetchDepth()));
+    auto thumbnailPersistenceStatus = connect(ui->actionKeepThumbnails,SIGNAL(toggled(bool)),this,SLOT(SetThumbnailPersistence(bool)));
+    auto directBlitStatus = connect(ui->actionDirectBlit,SIGNAL(toggled(bool)),this,SLOT(SetDirectBlit(bool)));
+    auto decodeAtViewSizeStatus = connect(ui->actionDecodeAtViewSize,SIGNAL(toggled(bool)),this,SLOT(SetDecodeAtViewSize(bool)));
+    auto paletteGroup = new QActionGroup(this);
+    paletteGroup->addAction(ui->actionPaletteTurbo);
+    paletteGroup->addAction(ui->actionPaletteJet);
+    paletteGroup->addAction(ui->actionPaletteGrayscale);
+    auto depthPaletteStatus = connect(paletteGroup,SIGNAL(triggered(QAction*)),this,SLOT(SetDepthPalette(QAction*)));
+    auto depthRangeStatus = connect(ui->actionDepthRange,SIGNAL(triggered()),this,SLOT(SetDepthRange()));
+    auto invalidDepthColorStatus = connect(ui->actionInvalidDepthColor,SIGNAL(triggered()),this,SLOT(SetInvalidDepthColor()));
+    auto autoDepthRangeStatus = connect(ui->actionAutoDepthRange,SIGNAL(toggled(bool)),this,SLOT(SetAutoDepthRange(bool)));
+    auto depthEqualizationStatus = connect(ui->actionDepthEqualization,SIGNAL(toggled(bool)),this,SLOT(SetDepthEqualization(bool)));
+    auto depthOverlayStatus = connect(ui->actionDepthOverlay,SIGNAL(toggled(bool)),this,SLOT(SetDepthOverlay(bool)));
+    auto overlayOpacityStatus = connect(ui->actionOverlayOpacity,SIGNAL(triggered()),this,SLOT(SetOverlayOpacity()));
+    auto frameDifferenceStatus = connect(ui->actionFrameDifference,SIGNAL(toggled(bool)),this,SLOT(SetFrameDifference(bool)));
+    auto differenceOptionsStatus = connect(ui->actionDifferenceOptions,SIGNAL(triggered()),this,SLOT(SetDifferenceOptions()));
+    auto syncToleranceStatus = connect(ui->actionSyncTolerance,SIGNAL(triggered()),this,SLOT(SetSyncTolerance()));
+    auto seekTimeStatus = connect(ui->actionSeekTime,SIGNAL(triggered()),this,SLOT(SeekToTime()));
+    auto syncReportStatus = connect(ui->actionSyncReport,SIGNAL(triggered()),this,SLOT(ShowSyncReport()));
+    auto benchmarkDecodingStatus = connect(ui->actionBenchmarkDecoding,SIGNAL(triggered()),this,SLOT(BenchmarkDecoding()));
+    auto benchmarkFormatsStatus = connect(ui->actionBenchmarkFormats,SIGNAL(triggered()),this,SLOT(BenchmarkPixelFormats()));
+    auto pointCloudStatus = connect(ui->actionPointCloud,SIGNAL(toggled(bool)),this,SLOT(SetPointCloudView(bool)));
+    auto irViewStatus = connect(ui->actionIrView,SIGNAL(toggled(bool)),this,SLOT(SetIrView(bool)));
 
     try {
         openni::OpenNI::initialize();
@@ -4,16 +4,30 @@
 #include <QMainWindow>
 #include <QMessageBox>
 #include <QFileDialog>
+#include <QInputDialog>
+#include <QLineEdit>
 #include <QGraphicsView>
 #include <QPixmap>
-#include <QGraphicsPixmapItem>
+#include <QElapsedTimer>
+#include <QActionGroup>
+#include <QColorDialog>
+#include <QEvent>
+#include <QThread>
 
 #include "Include/OpenNI.h"
 
 #include "device_vstream_info.h"
+#include "decode_benchmark.h"
+#include "frame_provider.h"
+#include "frame_prefetcher.h"
+#include "frame_surface_item.h"
+#include "point_cloud_widget.h"
+#include "thumbnail_track.h"
+#include "video_widget.h"
 #include "repeater.h"
 
 #include <chrono>
+#include <memory>
 
 #include "magic_enum.hpp"
 
@@ -33,11 +47,21 @@ public:
     void fastAlert(const QString& str);
     void setEnabledUi(bool enable);
     void setFrameByPosition(float_t pos);
+    void showFrame(int64_t frameNo);
+    void presentFrame(int64_t frameNo, const decodedFrame& frame);
     void restartPlaybackFromPos(float_t pos);
     void restartPlaybackFromFrame(int64_t pos);
-    QString buildTimeString(int64_t seconds);
+    QString buildTimeString(int64_t milliseconds);
+    bool parseTimeString(const QString& text, int64_t& milliseconds);
     void reinititialiseComponents();
+    bool createStreams();
     void safeSliderValueSet(int value);
+    void resetRenderStats();
+    void refreshFrame();
+    void updateDisplayDivisors();
+    void showDecodingBenchmark(const DecodeBenchmark::result& measured);
+protected:
+    bool eventFilter(QObject* watched, QEvent* event) override;
 private slots:
     void openFile();
     void initEverything();
@@ -48,20 +72,58 @@ private slots:
     void FirstFrame();
     void LastFrame();
     void SliderMove(int value);
+    void SeekToTime();
+    void SetCacheBudget();
+    void SetConversionThreads();
+    void SetMemoryMapping(bool enabled);
+    void SetDepthCompression(bool enabled);
+    void SetThumbnailPersistence(bool enabled);
+    void SetPrefetchDepth();
+    void SetDirectBlit(bool enabled);
+    void SetDecodeAtViewSize(bool enabled);
+    void SetDepthPalette(QAction* action);
+    void SetDepthRange();
+    void SetInvalidDepthColor();
+    void SetAutoDepthRange(bool enabled);
+    void SetDepthEqualization(bool enabled);
+    void SetDepthOverlay(bool enabled);
+    void SetOverlayOpacity();
+    void SetPointCloudView(bool enabled);
+    void SetIrView(bool enabled);
+    void SetFrameDifference(bool enabled);
+    void SetDifferenceOptions();
+    void SetSyncTolerance();
+    void ShowSyncReport();
+    void BenchmarkDecoding();
+    void BenchmarkPixelFormats();
 private:
     Repeater* repeater;
     QGraphicsScene* leftScene;
     QGraphicsScene* rightScene;
+    FrameSurfaceItem* leftDisplay;
+    FrameSurfaceItem* rightDisplay;
+    VideoWidget* leftVideo;
+    VideoWidget* rightVideo;
+    PointCloudWidget* cloudView;
+    VideoWidget* irVideo;
     Ui::MainWnd *ui;
     QMessageBox *msgBox;
     deviceVStreamInfo deviceWrapper;
-    QGraphicsPixmapItem* previousLeftPixmap;
-    QGraphicsPixmapItem* previousRightPixmap;
+    FrameProvider frameProvider;
+    FramePrefetcher prefetcher;
+    ThumbnailTrack thumbnails;
+    QString openedFile;
 
     time_frame_pair* playbackStartTime;
+    int64_t requestedFrame;
     int64_t currentFrame;
     int64_t nextFrame;
-    bool playbackEnabled, firstRun;
+    uint64_t droppedFrames;
+    uint64_t presentNanoseconds;
+    uint64_t presentCount;
+    uint64_t differenceNanoseconds;
+    uint64_t differenceCount;
+    bool playbackEnabled, firstRun, directBlit, decodeAtViewSize;
 
     QMutex mutex;
 };
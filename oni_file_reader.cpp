@@ -0,0 +1,452 @@
+#include "oni_file_reader.h"
+
+#include <QDataStream>
+#include <QDateTime>
+#include <QFileInfo>
+#include <QMutexLocker>
+
+#include <cstring>
+
+namespace {
+
+enum RecordType : uint32_t {
+    RECORD_NODE_ADDED_1_0_0_4 = 0x02,
+    RECORD_INT_PROPERTY = 0x03,
+    RECORD_REAL_PROPERTY = 0x04,
+    RECORD_STRING_PROPERTY = 0x05,
+    RECORD_GENERAL_PROPERTY = 0x06,
+    RECORD_NODE_REMOVED = 0x07,
+    RECORD_NODE_DATA_BEGIN = 0x08,
+    RECORD_NODE_STATE_READY = 0x09,
+    RECORD_NEW_DATA = 0x0A,
+    RECORD_END = 0x0B,
+    RECORD_NODE_ADDED_1_0_0_5 = 0x0C,
+    RECORD_NODE_ADDED = 0x0D,
+    RECORD_SEEK_TABLE = 0x0E
+};
+
+//legacy XnPixelFormat, older recordings carry only this one
+enum LegacyPixelFormat : uint64_t {
+    XN_PIXEL_FORMAT_RGB24 = 1,
+    XN_PIXEL_FORMAT_YUV422 = 2,
+    XN_PIXEL_FORMAT_GRAYSCALE_8_BIT = 3,
+    XN_PIXEL_FORMAT_GRAYSCALE_16_BIT = 4,
+    XN_PIXEL_FORMAT_MJPEG = 5
+};
+
+constexpr uint32_t recordMagic = 0x434E5258;//"XRNC", starts every record
+constexpr size_t seekTableEntrySize = 20;//u64 timestamp, u32 configuration id, u64 record position
+
+//little-endian reader over a record body, every read is bounds checked
+struct fieldCursor{
+    const uint8_t* data;
+    size_t size;
+    size_t pos;
+    template<typename T>
+    bool read(T& value){
+        if(pos + sizeof(T) > size)
+            return false;
+        std::memcpy(&value, data + pos, sizeof(T));
+        pos += sizeof(T);
+        return true;
+    }
+    bool readString(std::string& value){
+        uint32_t length = 0;
+        if(!read(length) || pos + length > size)
+            return false;
+        value.assign(reinterpret_cast<const char*>(data + pos), length);
+        while(!value.empty() && value.back() == '\0')
+            value.pop_back();
+        pos += length;
+        return true;
+    }
+    bool readBlob(std::vector<uint8_t>& value){
+        uint32_t length = 0;
+        if(!read(length) || pos + length > size)
+            return false;
+        value.assign(data + pos, data + pos + length);
+        pos += length;
+        return true;
+    }
+};
+
+}
+
+OniFileReader::OpenStatus OniFileReader::open(const QString& path, bool useSidecar){
+    close();
+    QMutexLocker locker(&fileAccess);
+    file.setFileName(path);
+    if(!file.open(QIODevice::ReadOnly))
+        return OpenStatus::CANNOT_OPEN;
+
+    char fileHeader[fileHeaderSize];
+    if(file.read(fileHeader, fileHeaderSize) != qint64(fileHeaderSize) || std::memcmp(fileHeader, "NIR", 4) != 0){
+        file.close();
+        return OpenStatus::NOT_AN_ONI_FILE;
+    }
+
+    QFileInfo fileInfo(path);
+    const qint64 fileModified = fileInfo.lastModified().toMSecsSinceEpoch();
+    if(useSidecar && loadSidecar(sidecarPathFor(path), file.size(), fileModified)){
+        indexFromSidecar = true;
+        return OpenStatus::OK;
+    }
+
+    auto status = scanRecords();
+    if(streamList.empty()){
+        file.close();
+        return status == OpenStatus::OK ? OpenStatus::NOT_AN_ONI_FILE : status;
+    }
+    //a damaged file gets rescanned every time, its index could change if the recording is repaired
+    if(useSidecar && status == OpenStatus::OK)
+        saveSidecar(sidecarPathFor(path), file.size(), fileModified);
+    return status;
+}
+
+OniFileReader::OpenStatus OniFileReader::scanRecords(){
+    const uint64_t fileSize = uint64_t(file.size());
+    uint64_t offset = fileHeaderSize;
+    std::vector<uint8_t> body;
+    auto status = OpenStatus::OK;
+    while(offset + recordHeaderSize <= fileSize){
+        recordHeader header;
+        if(!readRecordHeader(offset, header) || header.fieldsSize < recordHeaderSize ||
+           offset + header.fieldsSize + header.payloadSize > fileSize){
+            status = OpenStatus::TRUNCATED_RECORD;//keep whatever was indexed before the damage
+            break;
+        }
+        //garbage right after the file header isn't a recording at all
+        if(header.magic != recordMagic){
+            status = offset == fileHeaderSize ? OpenStatus::NOT_AN_ONI_FILE : OpenStatus::TRUNCATED_RECORD;
+            break;
+        }
+        if(header.type == RECORD_END)
+            break;
+        if(!readRecordBody(offset, header, body)){
+            status = OpenStatus::TRUNCATED_RECORD;
+            break;
+        }
+        parseRecord(offset, header, body);
+        offset += uint64_t(header.fieldsSize) + header.payloadSize;
+    }
+    for(auto& stream: streamList)
+        applyKnownProperties(stream);
+    return status;
+}
+
+void OniFileReader::close(){
+    QMutexLocker locker(&fileAccess);
+    mapping.reset();
+    if(file.isOpen())
+        file.close();
+    streamList.clear();
+    seekTablesFound = false;
+    indexFromSidecar = false;
+}
+
+const OniFileReader::streamInfo* OniFileReader::findStream(int32_t nodeType) const{
+    for(auto& stream: streamList)
+        if(stream.nodeType == nodeType)
+            return &stream;
+    return nullptr;
+}
+
+bool OniFileReader::readPayload(const streamInfo& stream, size_t frameIndex, std::vector<uint8_t>& payload){
+    if(frameIndex >= stream.frames.size())
+        return false;
+    auto& entry = stream.frames[frameIndex];
+    QMutexLocker locker(&fileAccess);
+    if(!file.isOpen() || !file.seek(qint64(entry.payloadOffset)))
+        return false;
+    payload.resize(entry.payloadSize);
+    return file.read(reinterpret_cast<char*>(payload.data()), entry.payloadSize) == qint64(entry.payloadSize);
+}
+
+bool OniFileReader::mapFile(){
+    QMutexLocker locker(&fileAccess);
+    if(!file.isOpen())
+        return false;
+    if(mapping)
+        return true;
+    //closing a QFile unmaps everything it mapped, views that outlive close() need a handle that outlives it too
+    auto mappedFile = std::make_shared<QFile>(file.fileName());
+    if(!mappedFile->open(QIODevice::ReadOnly))
+        return false;
+    uchar* base = mappedFile->map(0, mappedFile->size());
+    if(!base)
+        return false;
+    mapping = std::shared_ptr<uchar>(base, [mappedFile](uchar* base){ mappedFile->unmap(base); });
+    return true;
+}
+
+OniFileReader::streamInfo* OniFileReader::streamByNode(uint32_t nodeId){
+    for(auto& stream: streamList)
+        if(stream.nodeId == nodeId)
+            return &stream;
+    return nullptr;
+}
+
+bool OniFileReader::readRecordHeader(uint64_t offset, recordHeader& header){
+    uint8_t raw[recordHeaderSize];
+    if(!file.seek(qint64(offset)) || file.read(reinterpret_cast<char*>(raw), recordHeaderSize) != qint64(recordHeaderSize))
+        return false;
+    fieldCursor cursor{raw, recordHeaderSize, 0};
+    return cursor.read(header.magic) && cursor.read(header.type) && cursor.read(header.nodeId) &&
+           cursor.read(header.fieldsSize) && cursor.read(header.payloadSize) && cursor.read(header.undoRecordPos);
+}
+
+//frame records only need their fields, the payload is what gets skipped during the scan
+bool OniFileReader::readRecordBody(uint64_t offset, const recordHeader& header, std::vector<uint8_t>& body){
+    size_t bodySize = header.fieldsSize - recordHeaderSize;
+    if(header.type != RECORD_NEW_DATA)
+        bodySize += header.payloadSize;
+    body.resize(bodySize);
+    if(!bodySize)
+        return true;
+    return file.seek(qint64(offset + recordHeaderSize)) &&
+           file.read(reinterpret_cast<char*>(body.data()), qint64(bodySize)) == qint64(bodySize);
+}
+
+void OniFileReader::parseRecord(uint64_t offset, const recordHeader& header, const std::vector<uint8_t>& body){
+    fieldCursor cursor{body.data(), body.size(), 0};
+    switch(header.type){
+    case RECORD_NODE_ADDED_1_0_0_4:
+    case RECORD_NODE_ADDED_1_0_0_5:
+    case RECORD_NODE_ADDED:{
+        streamInfo stream;
+        stream.nodeId = header.nodeId;
+        uint32_t nodeType = 0;
+        if(!cursor.readString(stream.name) || !cursor.read(nodeType) || !cursor.read(stream.codec))
+            return;
+        stream.nodeType = int32_t(nodeType);
+        if(header.type != RECORD_NODE_ADDED_1_0_0_4){
+            cursor.read(stream.declaredFramesCount);
+            cursor.read(stream.minTimestamp);
+            cursor.read(stream.maxTimestamp);
+        }
+        if(stream.nodeType == NODE_TYPE_DEVICE)
+            return;
+        stream.frames.reserve(stream.declaredFramesCount);
+        if(auto existing = streamByNode(header.nodeId))
+            *existing = std::move(stream);
+        else
+            streamList.push_back(std::move(stream));
+        break;
+    }
+    case RECORD_INT_PROPERTY:
+    case RECORD_REAL_PROPERTY:
+    case RECORD_GENERAL_PROPERTY:{
+        auto stream = streamByNode(header.nodeId);
+        std::string propertyName;
+        if(!stream || !cursor.readString(propertyName))
+            return;
+        //every property carries its data size after the name, int and real ones are 8 bytes
+        if(header.type == RECORD_INT_PROPERTY){
+            uint32_t dataSize = 0;
+            uint64_t value = 0;
+            if(cursor.read(dataSize) && dataSize == sizeof(value) && cursor.read(value))
+                stream->intProperties[propertyName] = value;
+        }
+        else if(header.type == RECORD_REAL_PROPERTY){
+            uint32_t dataSize = 0;
+            double value = 0;
+            if(cursor.read(dataSize) && dataSize == sizeof(value) && cursor.read(value))
+                stream->realProperties[propertyName] = value;
+        }
+        else{
+            std::vector<uint8_t> value;
+            if(cursor.readBlob(value))
+                stream->generalProperties[propertyName] = std::move(value);
+        }
+        break;
+    }
+    case RECORD_NEW_DATA:{
+        auto stream = streamByNode(header.nodeId);
+        frameEntry entry;
+        if(!stream || !cursor.read(entry.timestamp) || !cursor.read(entry.frameId))
+            return;
+        entry.payloadOffset = offset + header.fieldsSize;
+        entry.payloadSize = header.payloadSize;
+        entry.codec = stream->codec;
+        stream->frames.push_back(entry);
+        break;
+    }
+    case RECORD_SEEK_TABLE:
+        //the scan above already has every offset, the table only tells the recording was finished properly
+        seekTablesFound = seekTablesFound || (header.payloadSize % seekTableEntrySize == 0 && header.payloadSize > 0);
+        break;
+    default:
+        break;
+    }
+}
+
+void OniFileReader::applyKnownProperties(streamInfo& stream){
+    auto mapOutputMode = stream.generalProperties.find("xnMapOutputMode");
+    if(mapOutputMode != stream.generalProperties.end() && mapOutputMode->second.size() >= 3*sizeof(uint32_t)){
+        uint32_t mode[3];
+        std::memcpy(mode, mapOutputMode->second.data(), sizeof(mode));
+        stream.width = int(mode[0]);
+        stream.height = int(mode[1]);
+        stream.fps = int(mode[2]);
+    }
+    auto fieldOfView = stream.generalProperties.find("xnFOV");
+    if(fieldOfView != stream.generalProperties.end() && fieldOfView->second.size() >= 2*sizeof(double)){
+        double fov[2];
+        std::memcpy(fov, fieldOfView->second.data(), sizeof(fov));
+        stream.horizontalFov = fov[0];
+        stream.verticalFov = fov[1];
+    }
+
+    auto pixelFormat = stream.intProperties.find("oniPixelFormat");
+    if(pixelFormat != stream.intProperties.end()){
+        stream.pixelFormat = int(pixelFormat->second);
+        return;
+    }
+    auto legacyFormat = stream.intProperties.find("xnPixelFormat");
+    if(legacyFormat != stream.intProperties.end()){
+        switch(legacyFormat->second){
+        case XN_PIXEL_FORMAT_RGB24: stream.pixelFormat = ONI_PIXEL_FORMAT_RGB888; break;
+        case XN_PIXEL_FORMAT_YUV422: stream.pixelFormat = ONI_PIXEL_FORMAT_YUV422; break;
+        case XN_PIXEL_FORMAT_GRAYSCALE_8_BIT: stream.pixelFormat = ONI_PIXEL_FORMAT_GRAY8; break;
+        case XN_PIXEL_FORMAT_GRAYSCALE_16_BIT: stream.pixelFormat = ONI_PIXEL_FORMAT_GRAY16; break;
+        case XN_PIXEL_FORMAT_MJPEG: stream.pixelFormat = ONI_PIXEL_FORMAT_JPEG; break;
+        default: break;
+        }
+        if(stream.pixelFormat)
+            return;
+    }
+    switch(stream.nodeType){
+    case NODE_TYPE_DEPTH: stream.pixelFormat = ONI_PIXEL_FORMAT_DEPTH_1_MM; break;
+    case NODE_TYPE_IMAGE: stream.pixelFormat = ONI_PIXEL_FORMAT_RGB888; break;
+    case NODE_TYPE_IR: stream.pixelFormat = ONI_PIXEL_FORMAT_GRAY16; break;
+    default: break;
+    }
+}
+
+namespace {
+
+constexpr char sidecarMagic[] = "ONIIDX";
+constexpr size_t sidecarEntrySize = 28;//how much one frameEntry takes in the stream
+constexpr quint32 sidecarMaxStreams = 64;//recordings have a handful of nodes, more is a damaged sidecar
+
+//uint64_t isn't quint64 everywhere (unsigned long vs unsigned long long), so 64-bit values go through these
+void writeU64(QDataStream& out, uint64_t value){
+    out << quint64(value);
+}
+void readU64(QDataStream& in, uint64_t& value){
+    quint64 wire = 0;
+    in >> wire;
+    value = wire;
+}
+
+void writeProperties(QDataStream& out, const OniFileReader::streamInfo& stream){
+    out << quint32(stream.intProperties.size());
+    for(auto& [name, value]: stream.intProperties){
+        out << QByteArray::fromStdString(name);
+        writeU64(out, value);
+    }
+    out << quint32(stream.realProperties.size());
+    for(auto& [name, value]: stream.realProperties)
+        out << QByteArray::fromStdString(name) << value;
+    out << quint32(stream.generalProperties.size());
+    for(auto& [name, value]: stream.generalProperties)
+        out << QByteArray::fromStdString(name) << QByteArray(reinterpret_cast<const char*>(value.data()), int(value.size()));
+}
+
+void readProperties(QDataStream& in, OniFileReader::streamInfo& stream){
+    quint32 count = 0;
+    in >> count;
+    for(quint32 i=0;i<count && in.status() == QDataStream::Ok;i++){
+        QByteArray name;
+        in >> name;
+        readU64(in, stream.intProperties[name.toStdString()]);
+    }
+    in >> count;
+    for(quint32 i=0;i<count && in.status() == QDataStream::Ok;i++){
+        QByteArray name;
+        in >> name >> stream.realProperties[name.toStdString()];
+    }
+    in >> count;
+    for(quint32 i=0;i<count && in.status() == QDataStream::Ok;i++){
+        QByteArray name, value;
+        in >> name >> value;
+        stream.generalProperties[name.toStdString()].assign(value.constData(), value.constData() + value.size());
+    }
+}
+
+}
+
+//the sidecar keeps everything the scan produced, so the properties don't have to be re-derived
+bool OniFileReader::loadSidecar(const QString& sidecarPath, qint64 fileSize, qint64 fileModified){
+    QFile sidecar(sidecarPath);
+    if(!sidecar.open(QIODevice::ReadOnly))
+        return false;
+    QDataStream in(&sidecar);
+    in.setByteOrder(QDataStream::LittleEndian);
+
+    QByteArray magic;
+    quint32 version = 0, streamsCount = 0;
+    qint64 storedSize = 0, storedModified = 0;
+    bool storedSeekTables = false;
+    in >> magic >> version >> storedSize >> storedModified >> storedSeekTables >> streamsCount;
+    if(in.status() != QDataStream::Ok || magic != sidecarMagic || version != sidecarVersion ||
+       storedSize != fileSize || storedModified != fileModified || streamsCount > sidecarMaxStreams)
+        return false;
+
+    std::vector<streamInfo> loaded(streamsCount);
+    for(auto& stream: loaded){
+        QByteArray name;
+        quint32 framesCount = 0;
+        in >> stream.nodeId >> name >> stream.nodeType >> stream.codec >> stream.declaredFramesCount;
+        readU64(in, stream.minTimestamp);
+        readU64(in, stream.maxTimestamp);
+        in >> stream.width >> stream.height >> stream.fps >> stream.pixelFormat >> stream.horizontalFov >> stream.verticalFov;
+        stream.name = name.toStdString();
+        readProperties(in, stream);
+        in >> framesCount;
+        if(in.status() != QDataStream::Ok || uint64_t(framesCount)*sidecarEntrySize > uint64_t(sidecar.size()))
+            return false;
+        stream.frames.resize(framesCount);
+        for(auto& entry: stream.frames){
+            readU64(in, entry.payloadOffset);
+            in >> entry.payloadSize >> entry.frameId;
+            readU64(in, entry.timestamp);
+            in >> entry.codec;
+        }
+    }
+    if(in.status() != QDataStream::Ok)
+        return false;
+    streamList = std::move(loaded);
+    seekTablesFound = storedSeekTables;
+    return true;
+}
+
+bool OniFileReader::saveSidecar(const QString& sidecarPath, qint64 fileSize, qint64 fileModified) const{
+    QFile sidecar(sidecarPath);
+    if(!sidecar.open(QIODevice::WriteOnly | QIODevice::Truncate))
+        return false;//read-only location, the next open just scans again
+    QDataStream out(&sidecar);
+    out.setByteOrder(QDataStream::LittleEndian);
+
+    out << QByteArray(sidecarMagic) << sidecarVersion << fileSize << fileModified << seekTablesFound << quint32(streamList.size());
+    for(auto& stream: streamList){
+        out << stream.nodeId << QByteArray::fromStdString(stream.name) << stream.nodeType << stream.codec << stream.declaredFramesCount;
+        writeU64(out, stream.minTimestamp);
+        writeU64(out, stream.maxTimestamp);
+        out << stream.width << stream.height << stream.fps << stream.pixelFormat << stream.horizontalFov << stream.verticalFov;
+        writeProperties(out, stream);
+        out << quint32(stream.frames.size());
+        for(auto& entry: stream.frames){
+            writeU64(out, entry.payloadOffset);
+            out << entry.payloadSize << entry.frameId;
+            writeU64(out, entry.timestamp);
+            out << entry.codec;
+        }
+    }
+    if(out.status() != QDataStream::Ok){
+        sidecar.close();
+        QFile::remove(sidecarPath);
+        return false;
+    }
+    return true;
+}
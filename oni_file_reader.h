@@ -0,0 +1,144 @@
+#ifndef ONI_FILE_READER_H
+#define ONI_FILE_READER_H
+
+#include <QFile>
+#include <QMutex>
+#include <QString>
+
+#include <cstdint>
+#include <map>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "Include/OniCEnums.h"
+
+//reads the ONI container by itself: no OpenNI, no replaying.
+//one pass over the record headers builds the per-stream frame index, payloads are read straight from the file
+class OniFileReader {
+public:
+    //XnCodecID values, four chars packed little-endian
+    enum Codec : uint32_t {
+        CODEC_NULL = 0,
+        CODEC_UNCOMPRESSED = 'N' | ('O'<<8) | ('N'<<16) | (uint32_t('E')<<24),
+        CODEC_JPEG = 'J' | ('P'<<8) | ('E'<<16) | (uint32_t('G')<<24),
+        CODEC_16Z = '1' | ('6'<<8) | ('z'<<16) | (uint32_t('P')<<24),
+        CODEC_16Z_EMB_TABLES = '1' | ('6'<<8) | ('z'<<16) | (uint32_t('T')<<24),
+        CODEC_8Z = 'I' | ('m'<<8) | ('8'<<16) | (uint32_t('z')<<24)
+    };
+    //XnPredefinedProductionNodeType values
+    enum NodeType : int32_t {
+        NODE_TYPE_DEVICE = 1,
+        NODE_TYPE_DEPTH = 2,
+        NODE_TYPE_IMAGE = 3,
+        NODE_TYPE_IR = 5
+    };
+    enum class OpenStatus{
+        OK,
+        CANNOT_OPEN,
+        NOT_AN_ONI_FILE,
+        TRUNCATED_RECORD
+    };
+    struct frameEntry{
+        uint64_t payloadOffset;
+        uint32_t payloadSize;
+        uint32_t frameId;
+        uint64_t timestamp;
+        uint32_t codec;
+    };
+    struct streamInfo{
+        uint32_t nodeId = 0;
+        std::string name;
+        int32_t nodeType = 0;
+        uint32_t codec = CODEC_NULL;
+        uint32_t declaredFramesCount = 0;//from the node-added record, may be 0 in old files
+        uint64_t minTimestamp = 0;
+        uint64_t maxTimestamp = 0;
+        int width = 0;
+        int height = 0;
+        int fps = 0;
+        int pixelFormat = 0;//OniPixelFormat
+        double horizontalFov = 0;
+        double verticalFov = 0;
+        std::map<std::string, uint64_t> intProperties;
+        std::map<std::string, double> realProperties;
+        std::map<std::string, std::vector<uint8_t>> generalProperties;
+        std::vector<frameEntry> frames;
+    };
+
+    OniFileReader() = default;
+    OniFileReader(const OniFileReader&) = delete;
+    OniFileReader& operator=(const OniFileReader&) = delete;
+
+    //with useSidecar the index is taken from <path>.idx when it matches the recording's size and mtime,
+    //and written there after a full scan otherwise
+    OpenStatus open(const QString& path, bool useSidecar = true);
+    //a truncated recording keeps the frames indexed before the damage and plays those
+    static bool isPlayable(OpenStatus status){
+        return status == OpenStatus::OK || status == OpenStatus::TRUNCATED_RECORD;
+    }
+    void close();
+    static QString sidecarPathFor(const QString& path){
+        return path + ".idx";
+    }
+    bool loadedFromSidecar() const{
+        return indexFromSidecar;
+    }
+    bool isOpen() const{
+        return file.isOpen();
+    }
+    const std::vector<streamInfo>& streams() const{
+        return streamList;
+    }
+    //first stream of that node type, nullptr if the file has none
+    const streamInfo* findStream(int32_t nodeType) const;
+    bool hasSeekTables() const{
+        return seekTablesFound;
+    }
+    //copies the raw (possibly still compressed) payload of one frame
+    bool readPayload(const streamInfo& stream, size_t frameIndex, std::vector<uint8_t>& payload);
+    //maps the whole recording, can fail for huge files in 32-bit builds, readPayload keeps working then
+    bool mapFile();
+    bool isMapped() const{
+        return mapping != nullptr;
+    }
+    //pointer straight into the mapping, empty when not mapped. it shares the mapping's ownership,
+    //the file stays mapped as long as any view lives, close() or not
+    std::shared_ptr<const uchar> payloadView(const streamInfo& stream, size_t frameIndex){
+        QMutexLocker locker(&fileAccess);
+        if(!mapping || frameIndex >= stream.frames.size())
+            return {};
+        return std::shared_ptr<const uchar>(mapping, mapping.get() + stream.frames[frameIndex].payloadOffset);
+    }
+private:
+    struct recordHeader{
+        uint32_t magic;
+        uint32_t type;
+        uint32_t nodeId;
+        uint32_t fieldsSize;//header included
+        uint32_t payloadSize;
+        uint64_t undoRecordPos;
+    };
+    static constexpr size_t fileHeaderSize = 24;
+    static constexpr size_t recordHeaderSize = 28;
+
+    static constexpr uint32_t sidecarVersion = 2;//2: int and real properties read past their data size
+
+    QFile file;
+    QMutex fileAccess;
+    std::vector<streamInfo> streamList;
+    bool seekTablesFound = false;
+    bool indexFromSidecar = false;
+    std::shared_ptr<uchar> mapping;//unmaps through a file handle of its own, see mapFile
+
+    streamInfo* streamByNode(uint32_t nodeId);
+    bool readRecordHeader(uint64_t offset, recordHeader& header);
+    bool readRecordBody(uint64_t offset, const recordHeader& header, std::vector<uint8_t>& body);
+    void parseRecord(uint64_t offset, const recordHeader& header, const std::vector<uint8_t>& body);
+    void applyKnownProperties(streamInfo& stream);
+    OpenStatus scanRecords();
+    bool loadSidecar(const QString& sidecarPath, qint64 fileSize, qint64 fileModified);
+    bool saveSidecar(const QString& sidecarPath, qint64 fileSize, qint64 fileModified) const;
+};
+
+#endif // ONI_FILE_READER_H
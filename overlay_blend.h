@@ -0,0 +1,91 @@
+#ifndef OVERLAY_BLEND_H
+#define OVERLAY_BLEND_H
+
+#include <QtGlobal>
+
+#include <cstdint>
+
+#if defined(__SSSE3__)
+#include <tmmintrin.h>
+#define OVERLAY_BLEND_SSSE3
+#endif
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define OVERLAY_BLEND_SSE2
+#endif
+
+//colormapped depth over the color frame: out = (overlay*alpha + color*(256 - alpha)) >> 8 per channel,
+//only where the depth lies within near..far; everything else, no depth included, stays plain color.
+//4 pixels a step, unpacking RGB888 takes a byte shuffle which needs SSSE3, SSE2 gathers it by hand
+class OverlayBlend {
+    static inline uint32_t blendOne(const uchar* rgb, uint32_t overlay, uint16_t depth,
+                                    uint16_t nearMm, uint16_t farMm, uint32_t alpha){
+        const uint32_t color = (uint32_t(rgb[0]) << 16) | (uint32_t(rgb[1]) << 8) | rgb[2];
+        if(!depth || depth < nearMm || depth > farMm)
+            return 0xff000000u | color;
+        uint32_t result = 0xff000000u;
+        for(int channel=0;channel<24;channel+=8){
+            const uint32_t c = (color >> channel) & 0xff, o = (overlay >> channel) & 0xff;
+            result |= ((o*alpha + c*(256 - alpha)) >> 8) << channel;
+        }
+        return result;
+    }
+public:
+    //alpha 0..256, out is 0xffRRGGBB
+    static void blendRow(const uchar* rgb, const uint32_t* overlay, const uint16_t* depth, uint32_t* out, int count,
+                         uint16_t nearMm, uint16_t farMm, uint32_t alpha){
+        int i = 0;
+#if defined(OVERLAY_BLEND_SSE2)
+        const __m128i zero = _mm_setzero_si128();
+        const __m128i opaque = _mm_set1_epi32(int(0xff000000u));
+        const __m128i overlayWeight = _mm_set1_epi16(short(alpha));
+        const __m128i colorWeight = _mm_set1_epi16(short(256 - alpha));
+        //unsigned compares through the sign bit, SSE2 only compares signed
+        const __m128i bias = _mm_set1_epi16(short(0x8000));
+        const __m128i nearV = _mm_xor_si128(_mm_set1_epi16(short(nearMm)), bias);
+        const __m128i farV = _mm_xor_si128(_mm_set1_epi16(short(farMm)), bias);
+#if defined(OVERLAY_BLEND_SSSE3)
+        const __m128i toBgra = _mm_setr_epi8(2, 1, 0, -1, 5, 4, 3, -1, 8, 7, 6, -1, 11, 10, 9, -1);
+#endif
+        //the shuffle loads 16 bytes for 12, two more pixels have to be there to read past
+        for(;i+6<=count;i+=4){
+#if defined(OVERLAY_BLEND_SSSE3)
+            __m128i color = _mm_shuffle_epi8(_mm_loadu_si128(reinterpret_cast<const __m128i*>(rgb + i*3)), toBgra);
+#else
+            const uchar* p = rgb + i*3;
+            __m128i color = _mm_setr_epi32(int((uint32_t(p[0]) << 16) | (uint32_t(p[1]) << 8) | p[2]),
+                                           int((uint32_t(p[3]) << 16) | (uint32_t(p[4]) << 8) | p[5]),
+                                           int((uint32_t(p[6]) << 16) | (uint32_t(p[7]) << 8) | p[8]),
+                                           int((uint32_t(p[9]) << 16) | (uint32_t(p[10]) << 8) | p[11]));
+#endif
+            color = _mm_or_si128(color, opaque);
+            __m128i over = _mm_loadu_si128(reinterpret_cast<const __m128i*>(overlay + i));
+            __m128i d = _mm_loadl_epi64(reinterpret_cast<const __m128i*>(depth + i));
+            __m128i biased = _mm_xor_si128(d, bias);
+            __m128i outside = _mm_or_si128(_mm_or_si128(_mm_cmpeq_epi16(d, zero), _mm_cmplt_epi16(biased, nearV)),
+                                           _mm_cmpgt_epi16(biased, farV));
+            outside = _mm_unpacklo_epi16(outside, outside);
+            __m128i low = _mm_srli_epi16(_mm_add_epi16(_mm_mullo_epi16(_mm_unpacklo_epi8(over, zero), overlayWeight),
+                                                       _mm_mullo_epi16(_mm_unpacklo_epi8(color, zero), colorWeight)), 8);
+            __m128i high = _mm_srli_epi16(_mm_add_epi16(_mm_mullo_epi16(_mm_unpackhi_epi8(over, zero), overlayWeight),
+                                                        _mm_mullo_epi16(_mm_unpackhi_epi8(color, zero), colorWeight)), 8);
+            __m128i blended = _mm_or_si128(_mm_packus_epi16(low, high), opaque);
+            blended = _mm_or_si128(_mm_and_si128(outside, color), _mm_andnot_si128(outside, blended));
+            _mm_storeu_si128(reinterpret_cast<__m128i*>(out + i), blended);
+        }
+#endif
+        for(;i<count;i++)
+            out[i] = blendOne(rgb + i*3, overlay[i], depth[i], nearMm, farMm, alpha);
+    }
+    static const char* kernelName(){
+#if defined(OVERLAY_BLEND_SSSE3)
+        return "SSSE3";
+#elif defined(OVERLAY_BLEND_SSE2)
+        return "SSE2";
+#else
+        return "scalar";
+#endif
+    }
+};
+
+#endif // OVERLAY_BLEND_H
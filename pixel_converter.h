@@ -0,0 +1,289 @@
+#ifndef PIXEL_CONVERTER_H
+#define PIXEL_CONVERTER_H
+
+#include <QImage>
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <vector>
+
+#include "Include/OniCEnums.h"
+
+#if defined(__SSSE3__)
+#include <tmmintrin.h>
+#define PIXEL_CONVERTER_SSSE3
+#endif
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define PIXEL_CONVERTER_SSE2
+#endif
+
+//recorded pixel formats to the two the views take: every color format to RGB888, every depth format
+//to millimeters (Grayscale16). the table is fixed at compile time, one row kernel per OniPixelFormat;
+//formats that already are what the views take have none and are used as they are.
+//YUV is full-range BT.601 like OpenNI's own conversion, in 16 bit fixed point: c*x is (x*128 * c*512) >> 16.
+//16 pixels a step, writing RGB888 out of planes takes byte shuffles which need SSSE3, SSE2 interleaves by hand
+class PixelConverter {
+public:
+    //what some formats need besides the pixels, the shift to depth table of the recording for now
+    struct context{
+        const uint16_t* shiftToDepth = nullptr;
+        size_t shiftToDepthSize = 0;
+    };
+    using rowKernel = void(*)(const uchar* source, uchar* target, int count, const context& state);
+    struct entry{
+        int pixelFormat;
+        const char* name;
+        bool isDepth;
+        int sourceBytesPerPixel;
+        rowKernel convertRow;//nullptr when the views take the format as it is
+        int targetBytesPerPixel() const{
+            return isDepth ? 2 : 3;
+        }
+        QImage::Format targetFormat() const{
+            return isDepth ? QImage::Format_Grayscale16 : QImage::Format_RGB888;
+        }
+    };
+    //PS1080's depth parameters, the defaults are what its driver reports; see shiftToDepthTable
+    struct shiftParameters{
+        uint64_t zeroPlaneDistance = 120;//mm
+        double zeroPlanePixelSize = 0.1042;//mm
+        double emitterDcmosDistance = 7.5;//cm
+        uint64_t constShift = 200;
+        uint64_t paramCoeff = 4;
+        uint64_t shiftScale = 10;
+        uint64_t pixelSizeFactor = 1;
+        uint64_t maxShift = 2047;
+        uint64_t maxDepth = 10000;//mm
+    };
+    //only stand-ins for what the recording doesn't tell: 9.3 shifts have 3 fraction bits to 9.2's 2, so the
+    //coefficient doubles, and their 12 bits go up to 4095
+    static shiftParameters defaultShiftParameters(int pixelFormat){
+        shiftParameters parameters;
+        if(pixelFormat == ONI_PIXEL_FORMAT_SHIFT_9_3){
+            parameters.paramCoeff = 8;
+            parameters.maxShift = 4095;
+        }
+        return parameters;
+    }
+private:
+    static inline uchar clampByte(int value){
+        return uchar(value < 0 ? 0 : value > 255 ? 255 : value);
+    }
+    //the same rounding as the vector code, so both give the same bytes
+    static inline int scaled(int value, int coefficient){
+        return (value*128*coefficient) >> 16;
+    }
+    static constexpr int redFromV = 718, greenFromU = 176, greenFromV = 366, blueFromU = 907;//coefficient*512
+
+    static inline void yuvToRgb(int y, int u, int v, uchar* rgb){
+        u -= 128;
+        v -= 128;
+        rgb[0] = clampByte(y + scaled(v, redFromV));
+        rgb[1] = clampByte(y - scaled(u, greenFromU) - scaled(v, greenFromV));
+        rgb[2] = clampByte(y + scaled(u, blueFromU));
+    }
+#if defined(PIXEL_CONVERTER_SSE2)
+    //16 bytes of each plane to 48 bytes of RGB888
+    static inline void storeRgb(__m128i r, __m128i g, __m128i b, uchar* target){
+#if defined(PIXEL_CONVERTER_SSSE3)
+        const __m128i r0 = _mm_setr_epi8(0, -1, -1, 1, -1, -1, 2, -1, -1, 3, -1, -1, 4, -1, -1, 5);
+        const __m128i r1 = _mm_setr_epi8(-1, -1, 6, -1, -1, 7, -1, -1, 8, -1, -1, 9, -1, -1, 10, -1);
+        const __m128i r2 = _mm_setr_epi8(-1, 11, -1, -1, 12, -1, -1, 13, -1, -1, 14, -1, -1, 15, -1, -1);
+        const __m128i g0 = _mm_setr_epi8(-1, 0, -1, -1, 1, -1, -1, 2, -1, -1, 3, -1, -1, 4, -1, -1);
+        const __m128i g1 = _mm_setr_epi8(5, -1, -1, 6, -1, -1, 7, -1, -1, 8, -1, -1, 9, -1, -1, 10);
+        const __m128i g2 = _mm_setr_epi8(-1, -1, 11, -1, -1, 12, -1, -1, 13, -1, -1, 14, -1, -1, 15, -1);
+        const __m128i b0 = _mm_setr_epi8(-1, -1, 0, -1, -1, 1, -1, -1, 2, -1, -1, 3, -1, -1, 4, -1);
+        const __m128i b1 = _mm_setr_epi8(-1, 5, -1, -1, 6, -1, -1, 7, -1, -1, 8, -1, -1, 9, -1, -1);
+        const __m128i b2 = _mm_setr_epi8(10, -1, -1, 11, -1, -1, 12, -1, -1, 13, -1, -1, 14, -1, -1, 15);
+        auto out = reinterpret_cast<__m128i*>(target);
+        _mm_storeu_si128(out, _mm_or_si128(_mm_or_si128(_mm_shuffle_epi8(r, r0), _mm_shuffle_epi8(g, g0)), _mm_shuffle_epi8(b, b0)));
+        _mm_storeu_si128(out + 1, _mm_or_si128(_mm_or_si128(_mm_shuffle_epi8(r, r1), _mm_shuffle_epi8(g, g1)), _mm_shuffle_epi8(b, b1)));
+        _mm_storeu_si128(out + 2, _mm_or_si128(_mm_or_si128(_mm_shuffle_epi8(r, r2), _mm_shuffle_epi8(g, g2)), _mm_shuffle_epi8(b, b2)));
+#else
+        alignas(16) uchar planes[3][16];
+        _mm_store_si128(reinterpret_cast<__m128i*>(planes[0]), r);
+        _mm_store_si128(reinterpret_cast<__m128i*>(planes[1]), g);
+        _mm_store_si128(reinterpret_cast<__m128i*>(planes[2]), b);
+        for(int i=0;i<16;i++){
+            target[i*3] = planes[0][i];
+            target[i*3 + 1] = planes[1][i];
+            target[i*3 + 2] = planes[2][i];
+        }
+#endif
+    }
+    //8 pixels of 4:2:2 to 16 bit R, G and B
+    template<bool lumaFirst>
+    static inline void yuvToRgb(__m128i pixels, __m128i& r, __m128i& g, __m128i& b){
+        const __m128i lowBytes = _mm_set1_epi16(0x00ff);
+        const __m128i lowWords = _mm_set1_epi32(0x0000ffff);
+        const __m128i bias = _mm_set1_epi16(128);
+        __m128i y = lumaFirst ? _mm_and_si128(pixels, lowBytes) : _mm_srli_epi16(pixels, 8);
+        __m128i chroma = lumaFirst ? _mm_srli_epi16(pixels, 8) : _mm_and_si128(pixels, lowBytes);//U V U V ...
+        __m128i u = _mm_and_si128(chroma, lowWords);
+        u = _mm_or_si128(u, _mm_slli_epi32(u, 16));//both pixels of a pair share it
+        __m128i v = _mm_srli_epi32(chroma, 16);
+        v = _mm_or_si128(v, _mm_slli_epi32(v, 16));
+        u = _mm_slli_epi16(_mm_sub_epi16(u, bias), 7);
+        v = _mm_slli_epi16(_mm_sub_epi16(v, bias), 7);
+        r = _mm_add_epi16(y, _mm_mulhi_epi16(v, _mm_set1_epi16(redFromV)));
+        g = _mm_sub_epi16(_mm_sub_epi16(y, _mm_mulhi_epi16(u, _mm_set1_epi16(greenFromU))), _mm_mulhi_epi16(v, _mm_set1_epi16(greenFromV)));
+        b = _mm_add_epi16(y, _mm_mulhi_epi16(u, _mm_set1_epi16(blueFromU)));
+    }
+#endif
+    //YUV422 is U Y V Y, YUYV is Y U Y V; a pair of pixels per 4 bytes, an odd last pixel has none
+    template<bool lumaFirst>
+    static void yuv422Row(const uchar* source, uchar* target, int count, const context&){
+        int i = 0;
+#if defined(PIXEL_CONVERTER_SSE2)
+        for(;i+16<=count;i+=16){
+            __m128i r0, g0, b0, r1, g1, b1;
+            yuvToRgb<lumaFirst>(_mm_loadu_si128(reinterpret_cast<const __m128i*>(source + i*2)), r0, g0, b0);
+            yuvToRgb<lumaFirst>(_mm_loadu_si128(reinterpret_cast<const __m128i*>(source + i*2 + 16)), r1, g1, b1);
+            storeRgb(_mm_packus_epi16(r0, r1), _mm_packus_epi16(g0, g1), _mm_packus_epi16(b0, b1), target + i*3);
+        }
+#endif
+        for(;i+2<=count;i+=2){
+            const uchar* pair = source + i*2;
+            const int y0 = lumaFirst ? pair[0] : pair[1], y1 = lumaFirst ? pair[2] : pair[3];
+            const int u = lumaFirst ? pair[1] : pair[0], v = lumaFirst ? pair[3] : pair[2];
+            yuvToRgb(y0, u, v, target + i*3);
+            yuvToRgb(y1, u, v, target + i*3 + 3);
+        }
+        if(i < count){
+            const uchar* pair = source + i*2;
+            yuvToRgb(lumaFirst ? pair[0] : pair[1], lumaFirst ? pair[1] : pair[0], 128, target + i*3);
+        }
+    }
+    static void gray8Row(const uchar* source, uchar* target, int count, const context&){
+        int i = 0;
+#if defined(PIXEL_CONVERTER_SSE2)
+        for(;i+16<=count;i+=16){
+            __m128i gray = _mm_loadu_si128(reinterpret_cast<const __m128i*>(source + i));
+            storeRgb(gray, gray, gray, target + i*3);
+        }
+#endif
+        for(;i<count;i++)
+            target[i*3] = target[i*3 + 1] = target[i*3 + 2] = source[i];
+    }
+    //PS1080 IR is 10 bit, its top 8 bits are shown; brighter values saturate
+    static void gray16Row(const uchar* source, uchar* target, int count, const context&){
+        auto values = reinterpret_cast<const uint16_t*>(source);
+        int i = 0;
+#if defined(PIXEL_CONVERTER_SSE2)
+        for(;i+16<=count;i+=16){
+            __m128i low = _mm_srli_epi16(_mm_loadu_si128(reinterpret_cast<const __m128i*>(values + i)), 2);
+            __m128i high = _mm_srli_epi16(_mm_loadu_si128(reinterpret_cast<const __m128i*>(values + i + 8)), 2);
+            __m128i gray = _mm_packus_epi16(low, high);
+            storeRgb(gray, gray, gray, target + i*3);
+        }
+#endif
+        for(;i<count;i++){
+            const int value = values[i] >> 2;
+            target[i*3] = target[i*3 + 1] = target[i*3 + 2] = uchar(value > 255 ? 255 : value);
+        }
+    }
+    //x/10 for every 16 bit x is (x*0xcccd) >> 19
+    static void depth100umRow(const uchar* source, uchar* target, int count, const context&){
+        auto values = reinterpret_cast<const uint16_t*>(source);
+        auto out = reinterpret_cast<uint16_t*>(target);
+        int i = 0;
+#if defined(PIXEL_CONVERTER_SSE2)
+        const __m128i tenth = _mm_set1_epi16(short(0xcccd));
+        for(;i+8<=count;i+=8){
+            __m128i x = _mm_loadu_si128(reinterpret_cast<const __m128i*>(values + i));
+            _mm_storeu_si128(reinterpret_cast<__m128i*>(out + i), _mm_srli_epi16(_mm_mulhi_epu16(x, tenth), 3));
+        }
+#endif
+        for(;i<count;i++)
+            out[i] = uint16_t(values[i]/10);
+    }
+    //a table lookup per pixel, there's nothing to vectorize without gathers and those don't beat an L1 hit;
+    //shifts off the table have no depth
+    static void shiftRow(const uchar* source, uchar* target, int count, const context& state){
+        auto values = reinterpret_cast<const uint16_t*>(source);
+        auto out = reinterpret_cast<uint16_t*>(target);
+        const uint16_t* table = state.shiftToDepth;
+        const size_t size = table ? state.shiftToDepthSize : 0;
+        int i = 0;
+        for(;i+4<=count;i+=4){
+            const uint16_t a = values[i], b = values[i + 1], c = values[i + 2], d = values[i + 3];
+            out[i] = a < size ? table[a] : 0;
+            out[i + 1] = b < size ? table[b] : 0;
+            out[i + 2] = c < size ? table[c] : 0;
+            out[i + 3] = d < size ? table[d] : 0;
+        }
+        for(;i<count;i++)
+            out[i] = values[i] < size ? table[values[i]] : 0;
+    }
+public:
+    static const std::array<entry, 10>& formats(){
+        static constexpr std::array<entry, 10> table{{
+            {ONI_PIXEL_FORMAT_DEPTH_1_MM, "DEPTH_1_MM", true, 2, nullptr},
+            {ONI_PIXEL_FORMAT_DEPTH_100_UM, "DEPTH_100_UM", true, 2, &depth100umRow},
+            {ONI_PIXEL_FORMAT_SHIFT_9_2, "SHIFT_9_2", true, 2, &shiftRow},
+            {ONI_PIXEL_FORMAT_SHIFT_9_3, "SHIFT_9_3", true, 2, &shiftRow},
+            {ONI_PIXEL_FORMAT_RGB888, "RGB888", false, 3, nullptr},
+            {ONI_PIXEL_FORMAT_YUV422, "YUV422", false, 2, &yuv422Row<false>},
+            {ONI_PIXEL_FORMAT_YUYV, "YUYV", false, 2, &yuv422Row<true>},
+            {ONI_PIXEL_FORMAT_GRAY8, "GRAY8", false, 1, &gray8Row},
+            {ONI_PIXEL_FORMAT_GRAY16, "GRAY16", false, 2, &gray16Row},
+            //JPEG is decoded to RGB888 before it gets here, see JpegDecoder
+            {ONI_PIXEL_FORMAT_JPEG, "JPEG", false, 3, nullptr}
+        }};
+        return table;
+    }
+    //nullptr for formats of the other kind of stream, or ones there's no kernel for
+    static const entry* find(int pixelFormat, bool isDepth){
+        for(auto& format: formats())
+            if(format.pixelFormat == pixelFormat && format.isDepth == isDepth)
+                return &format;
+        return nullptr;
+    }
+    //unknown formats, 0 included, are taken for what the views take, as before there was a table
+    static const entry& forFormat(int pixelFormat, bool isDepth){
+        if(auto format = find(pixelFormat, isDepth))
+            return *format;
+        return *find(isDepth ? ONI_PIXEL_FORMAT_DEPTH_1_MM : ONI_PIXEL_FORMAT_RGB888, isDepth);
+    }
+    static void convert(const entry& format, const uchar* source, int sourceStride, int width, int height,
+                        uchar* target, int targetStride, const context& state){
+        for(int row=0;row<height;row++){
+            const uchar* in = source + size_t(row)*sourceStride;
+            uchar* out = target + size_t(row)*targetStride;
+            if(format.convertRow)
+                format.convertRow(in, out, width, state);
+            else
+                std::memcpy(out, in, size_t(width)*format.targetBytesPerPixel());
+        }
+    }
+    //what the PS1080 driver computes (XnShiftToDepth): a shift is a disparity against the zero plane,
+    //depth follows from the triangle with the emitter. shifts off the device's depth range map to 0
+    static std::vector<uint16_t> shiftToDepthTable(const shiftParameters& parameters){
+        std::vector<uint16_t> table(parameters.maxShift + 1, 0);
+        const double pixelSize = parameters.zeroPlanePixelSize*parameters.pixelSizeFactor;
+        const double constShift = double(parameters.paramCoeff*parameters.constShift/std::max<uint64_t>(1, parameters.pixelSizeFactor));
+        for(size_t shift=1;shift<table.size();shift++){
+            const double metric = ((double(shift) - constShift)/double(parameters.paramCoeff) - 0.375)*pixelSize;
+            const double depth = double(parameters.shiftScale)*(metric*double(parameters.zeroPlaneDistance)/
+                                 (parameters.emitterDcmosDistance - metric) + double(parameters.zeroPlaneDistance));
+            if(depth > 0 && depth < double(parameters.maxDepth))
+                table[shift] = uint16_t(depth);
+        }
+        return table;
+    }
+    static const char* kernelName(){
+#if defined(PIXEL_CONVERTER_SSSE3)
+        return "SSSE3";
+#elif defined(PIXEL_CONVERTER_SSE2)
+        return "SSE2";
+#else
+        return "scalar";
+#endif
+    }
+};
+
+#endif // PIXEL_CONVERTER_H
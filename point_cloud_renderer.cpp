@@ -0,0 +1,212 @@
+#include "point_cloud_renderer.h"
+
+#include <QElapsedTimer>
+
+#include <algorithm>
+#include <cmath>
+#include <future>
+#include <limits>
+
+namespace {
+
+constexpr float nearClipMm = 10;
+
+}
+
+PointCloudRenderer::PointCloudRenderer(size_t threadCount):
+    threadCount(threadCount), horizontalFov(defaultHorizontalFov), verticalFov(defaultVerticalFov), rayStep(0),
+    renderNanoseconds(0), renderCount(0)
+{}
+
+void PointCloudRenderer::setFieldOfView(double horizontal, double vertical){
+    horizontalFov = horizontal > 0 ? horizontal : defaultHorizontalFov;
+    verticalFov = vertical > 0 ? vertical : defaultVerticalFov;
+    rebuildTables();
+}
+
+void PointCloudRenderer::setFrame(const frameBuffer& depth, const frameBuffer& colors){
+    depthBuffer = depth;
+    colorBuffer = colors;
+    const QSize oldDepthSize = depthImage.size(), oldColorSize = colorImage.size();
+    depthImage = depth.image();
+    colorImage = colors.image();
+    if(!colorImage.isNull() && colorImage.format() != QImage::Format_RGB32)
+        colorImage = colorImage.convertToFormat(QImage::Format_RGB32);
+    if(depthImage.size() != oldDepthSize || colorImage.size() != oldColorSize)
+        rebuildTables();
+}
+
+void PointCloudRenderer::clear(){
+    setFrame(frameBuffer(), frameBuffer());
+}
+
+void PointCloudRenderer::orbit(float yawDelta, float pitchDelta){
+    camera.yaw += yawDelta;
+    camera.pitch = std::max(-1.55f, std::min(1.55f, camera.pitch + pitchDelta));
+}
+
+void PointCloudRenderer::zoom(float factor){
+    camera.distanceMm = std::max(100.f, std::min(50000.f, camera.distanceMm*factor));
+}
+
+void PointCloudRenderer::resetCamera(){
+    camera = orbitCamera();
+}
+
+//rays go through pixel centers, x to the right and y up
+void PointCloudRenderer::rebuildTables(){
+    const int width = depthImage.width(), height = depthImage.height();
+    const double tanX = std::tan(horizontalFov/2), tanY = std::tan(verticalFov/2);
+    rayX.resize(std::max(0, width));
+    rayY.resize(std::max(0, height));
+    for(int u=0;u<width;u++)
+        rayX[u] = float((u + 0.5 - width/2.)/(width/2.)*tanX);
+    for(int v=0;v<height;v++)
+        rayY[v] = float((height/2. - v - 0.5)/(height/2.)*tanY);
+    rayStep = width ? float(2*tanX/width) : 0;
+    colorColumns.resize(colorImage.isNull() ? 0 : width);
+    colorRows.resize(colorImage.isNull() ? 0 : height);
+    for(int u=0;u<int(colorColumns.size());u++)
+        colorColumns[u] = int(int64_t(u)*colorImage.width()/width);
+    for(int v=0;v<int(colorRows.size());v++)
+        colorRows[v] = int(int64_t(v)*colorImage.height()/height);
+}
+
+//pitch around x after yaw around y; the focal length fits the sensor's field of view into the target
+PointCloudRenderer::transform PointCloudRenderer::viewTransform(const QSize& size) const{
+    transform view;
+    const float cy = std::cos(camera.yaw), sy = std::sin(camera.yaw);
+    const float cp = std::cos(camera.pitch), sp = std::sin(camera.pitch);
+    const float rotation[9] = {
+        cy,       0,   sy,
+        sp*sy,    cp, -sp*cy,
+        -cp*sy,   sp,  cp*cy
+    };
+    std::copy(std::begin(rotation), std::end(rotation), view.rotation);
+    view.pivot = camera.pivotMm;
+    view.distance = camera.distanceMm;
+    view.focal = float(std::min(size.width()/2./std::tan(horizontalFov/2), size.height()/2./std::tan(verticalFov/2)));
+    view.centerX = size.width()/2.f;
+    view.centerY = size.height()/2.f;
+    return view;
+}
+
+void PointCloudRenderer::projectRows(size_t chunk, int firstRow, int lastRow, const transform& view, const QSize& size, int bandHeight){
+    auto& chunkBins = bins[chunk];
+    const float* r = view.rotation;
+    const int width = depthImage.width();
+    const bool colored = !colorColumns.empty();
+    for(int v=firstRow;v<lastRow;v++){
+        auto depthRow = reinterpret_cast<const uint16_t*>(depthImage.constScanLine(v));
+        auto colorRow = colored ? reinterpret_cast<const uint32_t*>(colorImage.constScanLine(colorRows[v])) : nullptr;
+        const float rayYv = rayY[v];
+        for(int u=0;u<width;u++){
+            const uint16_t depth = depthRow[u];
+            if(!depth)
+                continue;
+            const float z = depth;
+            const float x = rayX[u]*z, y = rayYv*z, relativeZ = z - view.pivot;
+            const float cameraZ = r[6]*x + r[7]*y + r[8]*relativeZ + view.distance;
+            if(cameraZ < nearClipMm)
+                continue;
+            const float scale = view.focal/cameraZ;
+            const float screenX = view.centerX + (r[0]*x + r[1]*y + r[2]*relativeZ)*scale;
+            const float screenY = view.centerY - (r[3]*x + r[4]*y + r[5]*relativeZ)*scale;
+            splat point;
+            point.size = std::max(1, std::min(maxSplatSize, int(std::ceil(rayStep*z*scale))));
+            point.x = int(std::floor(screenX)) - point.size/2;
+            point.y = int(std::floor(screenY)) - point.size/2;
+            if(point.x + point.size <= 0 || point.x >= size.width() || point.y + point.size <= 0 || point.y >= size.height())
+                continue;
+            point.depth = cameraZ;
+            if(colored)
+                point.color = 0xff000000u | colorRow[colorColumns[u]];
+            else{
+                const uint32_t gray = 255 - std::min<uint32_t>(255, depth >> 5);
+                point.color = 0xff000000u | (gray << 16) | (gray << 8) | gray;
+            }
+            const int firstBand = std::max(0, point.y)/bandHeight;
+            const int lastBand = std::min(size.height() - 1, point.y + point.size - 1)/bandHeight;
+            for(int band=firstBand;band<=lastBand;band++)
+                chunkBins[band].push_back(point);
+        }
+    }
+}
+
+void PointCloudRenderer::splatBand(int band, int bandHeight, uchar* pixels, int bytesPerLine, const QSize& size){
+    const int width = size.width();
+    const int top = band*bandHeight, bottom = std::min(size.height(), top + bandHeight);
+    std::fill(zBuffer.begin() + size_t(top)*width, zBuffer.begin() + size_t(bottom)*width, std::numeric_limits<float>::max());
+    for(int y=top;y<bottom;y++){
+        auto row = reinterpret_cast<uint32_t*>(pixels + size_t(y)*bytesPerLine);
+        std::fill(row, row + width, background);
+    }
+    for(auto& chunkBins: bins){
+        for(auto& point: chunkBins[band]){
+            const int x0 = std::max(0, point.x), x1 = std::min(width, point.x + point.size);
+            const int y0 = std::max(top, point.y), y1 = std::min(bottom, point.y + point.size);
+            for(int y=y0;y<y1;y++){
+                float* depths = zBuffer.data() + size_t(y)*width;
+                auto row = reinterpret_cast<uint32_t*>(pixels + size_t(y)*bytesPerLine);
+                for(int x=x0;x<x1;x++){
+                    if(point.depth < depths[x]){
+                        depths[x] = point.depth;
+                        row[x] = point.color;
+                    }
+                }
+            }
+        }
+    }
+}
+
+QImage PointCloudRenderer::render(const QSize& size){
+    QElapsedTimer timer;
+    timer.start();
+    QImage target(size, QImage::Format_RGB32);
+    if(size.isEmpty())
+        return target;
+    if(!hasFrame() || depthImage.format() != QImage::Format_Grayscale16 || rayX.size() != size_t(depthImage.width())){
+        target.fill(background);
+        return target;
+    }
+    if(!pool)
+        pool = std::make_unique<ConversionPool>(threadCount);
+    const transform view = viewTransform(size);
+    const size_t threads = pool->threadCount();
+    const int bandCount = int(std::min<size_t>(size_t(size.height()), threads*4));
+    const int bandHeight = std::max(maxSplatSize, (size.height() + bandCount - 1)/bandCount);
+    const size_t chunkCount = std::min<size_t>(size_t(depthImage.height()), threads*2);
+    const int bandsUsed = (size.height() + bandHeight - 1)/bandHeight;
+    bins.resize(chunkCount);
+    for(auto& chunkBins: bins){
+        chunkBins.resize(size_t(bandsUsed));
+        for(auto& bin: chunkBins)
+            bin.clear();
+    }
+    zBuffer.resize(size_t(size.width())*size.height());
+
+    std::vector<std::future<void>> tasks;
+    const int rowsPerChunk = int((depthImage.height() + chunkCount - 1)/chunkCount);
+    for(size_t chunk=0;chunk<chunkCount;chunk++){
+        const int firstRow = int(chunk)*rowsPerChunk, lastRow = std::min(depthImage.height(), firstRow + rowsPerChunk);
+        tasks.push_back(pool->submit([this, chunk, firstRow, lastRow, &view, size, bandHeight](){
+            projectRows(chunk, firstRow, lastRow, view, size, bandHeight);
+        }));
+    }
+    for(auto& task: tasks)
+        task.get();
+    tasks.clear();
+    //taken once here, scanLine() on the workers would race on the image's detach check
+    uchar* pixels = target.bits();
+    const int bytesPerLine = int(target.bytesPerLine());
+    for(int band=0;band<bandsUsed;band++)
+        tasks.push_back(pool->submit([this, band, bandHeight, pixels, bytesPerLine, size](){
+            splatBand(band, bandHeight, pixels, bytesPerLine, size);
+        }));
+    for(auto& task: tasks)
+        task.get();
+
+    renderNanoseconds += timer.nsecsElapsed();
+    renderCount++;
+    return target;
+}
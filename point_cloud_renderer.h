@@ -0,0 +1,88 @@
+#ifndef POINT_CLOUD_RENDERER_H
+#define POINT_CLOUD_RENDERER_H
+
+#include <QImage>
+#include <QSize>
+
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+#include "conversion_pool.h"
+#include "device_vstream_info.h"
+
+//depth as 3d points, drawn on the cpu. every depth pixel is a ray through the sensor's field of view, the rays
+//are tabulated per column and per row whenever the depth size or the field of view change. rendering runs in
+//two parallel passes on the renderer's own pool, started with the first frame rendered: row chunks of the
+//depth frame are projected and binned into horizontal screen bands, then every band is splatted with its own
+//z-buffer rows, so no two threads ever write the same pixel. points are squares sized to the area their depth
+//pixel covers, which closes the gaps up close
+class PointCloudRenderer {
+public:
+    //orbit around a pivot on the sensor axis, at the start the view is the sensor's own
+    struct orbitCamera{
+        float yaw = 0;//radians
+        float pitch = 0;
+        float pivotMm = 2000;
+        float distanceMm = 2000;//from the pivot
+    };
+    static constexpr double defaultHorizontalFov = 1.0225;//58 degrees, PrimeSense depth
+    static constexpr double defaultVerticalFov = 0.7959;//45.6 degrees
+    static constexpr int maxSplatSize = 4;
+    static constexpr uint32_t background = 0xff202020u;
+
+    explicit PointCloudRenderer(size_t threadCount = ConversionPool::defaultThreadCount());
+
+    //radians, zero or less keeps the defaults
+    void setFieldOfView(double horizontal, double vertical);
+    //depth in mm; colors is any RGB32 frame of the same moment (colormapped depth, the overlay), stretched to depth
+    void setFrame(const frameBuffer& depth, const frameBuffer& colors);
+    void clear();
+    bool hasFrame() const{ return !depthImage.isNull(); }
+
+    orbitCamera camera;
+    void orbit(float yawDelta, float pitchDelta);
+    void zoom(float factor);
+    void resetCamera();
+
+    QImage render(const QSize& size);
+    double averageRenderMs() const{
+        return renderCount ? renderNanoseconds/1e6/renderCount : 0.;
+    }
+    void resetStats(){
+        renderNanoseconds = 0;
+        renderCount = 0;
+    }
+private:
+    struct splat{
+        int x, y;
+        int size;
+        float depth;//distance along the view axis
+        uint32_t color;
+    };
+    struct transform{
+        float rotation[9];
+        float pivot, distance;
+        float focal, centerX, centerY;
+    };
+
+    size_t threadCount;
+    std::unique_ptr<ConversionPool> pool;//nothing idles for a view that's never shown
+    double horizontalFov, verticalFov;
+    frameBuffer depthBuffer, colorBuffer;//keep the pixels behind the images alive
+    QImage depthImage, colorImage;
+    std::vector<float> rayX, rayY;//tan of the angle off the axis, per column and row
+    std::vector<int> colorColumns, colorRows;
+    float rayStep;
+    std::vector<std::vector<std::vector<splat>>> bins;//[chunk][band], kept between frames for their capacity
+    std::vector<float> zBuffer;
+    uint64_t renderNanoseconds;
+    uint64_t renderCount;
+
+    void rebuildTables();
+    transform viewTransform(const QSize& size) const;
+    void projectRows(size_t chunk, int firstRow, int lastRow, const transform& view, const QSize& size, int bandHeight);
+    void splatBand(int band, int bandHeight, uchar* pixels, int bytesPerLine, const QSize& size);
+};
+
+#endif // POINT_CLOUD_RENDERER_H
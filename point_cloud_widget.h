@@ -0,0 +1,66 @@
+#ifndef POINT_CLOUD_WIDGET_H
+#define POINT_CLOUD_WIDGET_H
+
+#include <QWidget>
+#include <QPainter>
+#include <QPaintEvent>
+#include <QMouseEvent>
+#include <QWheelEvent>
+#include <QImage>
+
+#include "point_cloud_renderer.h"
+
+//the third view: drag with the left button to orbit, wheel to zoom, right click goes back to the sensor's view.
+//a frame is rendered when the widget is painted, so frames and camera moves in between are coalesced
+class PointCloudWidget : public QWidget {
+    PointCloudRenderer renderer;
+    QPoint lastPosition;
+protected:
+    void paintEvent(QPaintEvent*) override{
+        QPainter painter(this);
+        painter.drawImage(0, 0, renderer.render(size()));
+    }
+    void mousePressEvent(QMouseEvent* event) override{
+        lastPosition = event->pos();
+        if(event->button() == Qt::RightButton){
+            renderer.resetCamera();
+            update();
+        }
+    }
+    void mouseMoveEvent(QMouseEvent* event) override{
+        if(!(event->buttons() & Qt::LeftButton))
+            return;
+        const QPoint position = event->pos();
+        renderer.orbit((position.x() - lastPosition.x())*0.01f, (position.y() - lastPosition.y())*0.01f);
+        lastPosition = position;
+        update();
+    }
+    void wheelEvent(QWheelEvent* event) override{
+        renderer.zoom(event->angleDelta().y() > 0 ? 0.9f : 1.1f);
+        update();
+    }
+public:
+    explicit PointCloudWidget(QWidget* parent = nullptr): QWidget(parent) {
+        setAttribute(Qt::WA_OpaquePaintEvent);
+    }
+    void setFieldOfView(double horizontal, double vertical){
+        renderer.setFieldOfView(horizontal, vertical);
+        update();
+    }
+    void setFrame(const frameBuffer& depth, const frameBuffer& colors){
+        renderer.setFrame(depth, colors);
+        update();
+    }
+    void clear(){
+        renderer.clear();
+        update();
+    }
+    double averageRenderMs() const{
+        return renderer.averageRenderMs();
+    }
+    void resetStats(){
+        renderer.resetStats();
+    }
+};
+
+#endif // POINT_CLOUD_WIDGET_H
@@ -0,0 +1,120 @@
+#ifndef PS_DEPTH_DECODER_H
+#define PS_DEPTH_DECODER_H
+
+#include <algorithm>
+#include <cstdint>
+#include <vector>
+
+//PrimeSense's own depth compression as OniFile stores it, decoded without OpenNI.
+//16z: the first value as 16 bits, then per byte two nibbles of (previous - current) + 6, where nibble 0xd
+//escapes the second half and 0xf pads it; 0xff escapes a whole byte. an escape is followed by either a
+//byte with the high bit set, (previous - current) + 192, or the new value as two bytes, high one first.
+//0xe0 + n repeats the previous value 2n times.
+//16zT: the same over indices into a table of depths that precedes the data (16 bit count, then entries).
+//every frame stands on its own, so frames decode in parallel even though a single one can't
+class PsDepthDecoder {
+    static uint16_t read16(const uint8_t* data){
+        return uint16_t(data[0] | (data[1] << 8));
+    }
+    //identity for 16z, table lookup for 16zT; an index off the table fails the frame
+    struct direct{
+        bool operator()(uint16_t value, uint16_t& depth) const{
+            depth = value;
+            return true;
+        }
+    };
+    struct lookup{
+        const uint16_t* table;
+        size_t size;
+        bool operator()(uint16_t index, uint16_t& depth) const{
+            if(index >= size)
+                return false;
+            depth = table[index];
+            return true;
+        }
+    };
+    template<typename Map>
+    static bool run(const uint8_t* in, const uint8_t* end, uint16_t* out, size_t pixels, const Map& map){
+        uint16_t* const outEnd = out + pixels;
+        if(end - in < 2 || !pixels)
+            return false;
+        uint16_t last = read16(in);
+        uint16_t depth;
+        in += 2;
+        if(!map(last, depth))
+            return false;
+        *out++ = depth;
+        //value or escape after 0xd / 0xff
+        auto escaped = [&]() -> bool{
+            if(in == end)
+                return false;
+            const uint8_t first = *in++;
+            if(first & 0x80)
+                last = uint16_t(last - (int(first) - 192));
+            else{
+                if(in == end)
+                    return false;
+                last = uint16_t((first << 8) | *in++);
+            }
+            return true;
+        };
+        while(in != end){
+            const uint8_t byte = *in++;
+            if(byte < 0xe0){
+                if(out == outEnd)
+                    return false;
+                last = uint16_t(last - ((byte >> 4) - 6));
+                if(!map(last, depth))
+                    return false;
+                *out++ = depth;
+                const int low = byte & 0x0f;
+                if(low == 0x0f)
+                    continue;
+                if(low == 0x0d){
+                    if(!escaped())
+                        return false;
+                }
+                else
+                    last = uint16_t(last - (low - 6));
+                if(out == outEnd || !map(last, depth))
+                    return false;
+                *out++ = depth;
+            }
+            else if(byte == 0xff){
+                if(!escaped() || out == outEnd || !map(last, depth))
+                    return false;
+                *out++ = depth;
+            }
+            else{
+                const size_t repeats = size_t(byte - 0xe0)*2;
+                if(size_t(outEnd - out) < repeats)
+                    return false;
+                if(!map(last, depth))
+                    return false;
+                std::fill(out, out + repeats, depth);
+                out += repeats;
+            }
+        }
+        return out == outEnd;
+    }
+public:
+    //false for malformed data, or data that doesn't fill exactly pixels values
+    static bool decode16z(const uint8_t* data, size_t size, uint16_t* out, size_t pixels){
+        return run(data, data + size, out, pixels, direct());
+    }
+    static bool decode16zWithTable(const uint8_t* data, size_t size, uint16_t* out, size_t pixels){
+        if(size < 2)
+            return false;
+        const size_t tableSize = read16(data);
+        if(size < 2 + tableSize*2)
+            return false;
+        //the table follows a 2 byte count, copied out since it doesn't have to be aligned
+        std::vector<uint16_t> table(tableSize);
+        for(size_t i=0;i<tableSize;i++)
+            table[i] = read16(data + 2 + i*2);
+        const uint8_t* values = data + 2 + tableSize*2;
+        return run(values, data + size, out, pixels, lookup{table.data(), tableSize});
+    }
+};
+
+#endif // PS_DEPTH_DECODER_H
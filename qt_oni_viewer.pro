@@ -10,13 +10,39 @@ CONFIG += c++17
 
 SOURCES += \
     main.cpp \
-    mainwnd.cpp
+    mainwnd.cpp \
+    oni_file_reader.cpp \
+    point_cloud_renderer.cpp \
+    thumbnail_track.cpp
 
 HEADERS += \
     ./Include/OpenNI.h \
+    conversion_pool.h \
+    decode_benchmark.h \
+    depth_codec.h \
+    depth_colormap.h \
+    depth_histogram.h \
     device_vstream_info.h \
+    frame_arena.h \
+    frame_cache.h \
+    frame_diff.h \
+    frame_prefetcher.h \
+    frame_provider.h \
+    frame_scaler.h \
+    frame_surface_item.h \
+    ir_gain.h \
+    jpeg_decoder.h \
     mainwnd.h \
-    repeater.h
+    oni_file_reader.h \
+    overlay_blend.h \
+    pixel_converter.h \
+    point_cloud_renderer.h \
+    point_cloud_widget.h \
+    ps_depth_decoder.h \
+    repeater.h \
+    stream_sync.h \
+    thumbnail_track.h \
+    video_widget.h
 
 FORMS += \
     mainwnd.ui
@@ -28,5 +54,16 @@ else: unix:!android: target.path = /opt/$${TARGET}/bin
 
 LIBS += -L$$PWD/lib/ -lOpenNI2
 
+# JPEG color goes through libjpeg-turbo with qmake CONFIG+=turbojpeg, through Qt's JPEG reader otherwise
+turbojpeg {
+    DEFINES += ONI_VIEWER_TURBOJPEG
+    LIBS += -lturbojpeg
+}
+
 INCLUDEPATH += $$PWD/Include
 DEPENDPATH += $$PWD/Include
+
+# make check builds tests/tests.pro next to the viewer and runs it
+kernel_tests.target = check
+kernel_tests.commands = $(MKDIR) tests && cd tests && $(QMAKE) $$shell_quote($$PWD/tests/tests.pro) && $(MAKE) check
+QMAKE_EXTRA_TARGETS += kernel_tests
@@ -2,26 +2,74 @@
 #define REPEATER_H
 
 #include <functional>
+#include <chrono>
 #include <QTimer>
 
+//calls func once per period against absolute deadlines, so a 16.67 ms period doesn't drift into 16 or 17 ms.
+//a tick that comes later than half a period counts as late, deadlines missed entirely are skipped, not fired in a burst
 class Repeater : public QObject {
 private:
     Q_OBJECT
+    using clock = std::chrono::steady_clock;
     std::function<void()> func;
     QTimer timer;
+    std::chrono::nanoseconds period;
+    clock::time_point nextDeadline;
+    uint64_t lateTicks;
+    uint64_t skippedTicks;
+
+    void arm(){
+        //QTimer counts whole milliseconds, rounding up keeps it from firing before the deadline
+        auto wait = std::chrono::ceil<std::chrono::milliseconds>(nextDeadline - clock::now()).count();
+        timer.start(int(wait > 0 ? wait : 0));
+    }
 public slots:
     void repeatingFunc(){
+        auto now = clock::now();
+        if(now - nextDeadline > period/2)
+            lateTicks++;
         func();
+        nextDeadline += period;
+        now = clock::now();
+        if(nextDeadline <= now){
+            auto behind = (now - nextDeadline)/period + 1;
+            skippedTicks += behind;
+            nextDeadline += behind*period;
+        }
+        arm();
     }
 public:
-    Repeater(const std::function<void()>& func, int64_t periodMS): func(func), timer(this) {
+    Repeater(const std::function<void()>& func, int64_t periodMS):
+        func(func), timer(this), period(std::chrono::milliseconds(periodMS)),
+        nextDeadline(clock::now() + period), lateTicks(0), skippedTicks(0) {
         connect(&timer, SIGNAL(timeout()), this, SLOT(repeatingFunc()));
-        timer.start(periodMS);
+        timer.setTimerType(Qt::PreciseTimer);
+        timer.setSingleShot(true);
+        arm();
     }
     ~Repeater(){
         timer.stop();
         disconnect(&timer, SIGNAL(timeout()), this, SLOT(repeatingFunc()));
     }
+    //restarts the deadlines from now
+    void setPeriod(std::chrono::nanoseconds newPeriod){
+        period = newPeriod.count() > 0 ? newPeriod : std::chrono::nanoseconds(std::chrono::milliseconds(33));
+        nextDeadline = clock::now() + period;
+        arm();
+    }
+    std::chrono::nanoseconds getPeriod() const{
+        return period;
+    }
+    uint64_t late() const{
+        return lateTicks;
+    }
+    uint64_t skipped() const{
+        return skippedTicks;
+    }
+    void resetStats(){
+        lateTicks = 0;
+        skippedTicks = 0;
+    }
 };
 
 #endif // REPEATER_H
@@ -0,0 +1,190 @@
+#ifndef STREAM_SYNC_H
+#define STREAM_SYNC_H
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <cstdint>
+#include <functional>
+#include <vector>
+
+//pairs the streams of a recording by their timestamps rather than their read order. the display ticks
+//are the frames of a reference stream, the one of depth and color with more frames; every other
+//stream shows its frame nearest to the tick, if that's within the tolerance, and nothing otherwise.
+//a lookup is a binary search. the timestamps are fixed once built, the tolerance can change any time.
+//recordings without usable timestamps (or none known) fall back to pairing by index
+class StreamSync {
+public:
+    enum Stream{
+        DEPTH,
+        COLOR,
+        IR,
+        STREAM_COUNT
+    };
+    static constexpr size_t noFrame = size_t(-1);
+    //how one stream lines up with the ticks, over the whole recording
+    struct driftStats{
+        size_t frames = 0;
+        size_t matched = 0;//ticks with a frame within the tolerance
+        size_t unmatched = 0;
+        size_t dropped = 0;//frames missing from the stream's own rate, from gaps in its timestamps
+        double meanOffsetMs = 0;//of the matched ones
+        double maxOffsetMs = 0;
+        double indexPairingMs = 0;//the worst offset pairing by read order would have had
+    };
+private:
+    std::array<std::vector<uint64_t>, STREAM_COUNT> timestamps;//microseconds
+    Stream reference = DEPTH;
+    bool timed = false;
+    size_t tickCount = 0;
+    uint64_t tickPeriod = 0;
+    std::atomic<uint64_t> toleranceUs{0};//0 is half a tick
+
+    //nearest frame and how far it is, noFrame for an empty stream
+    size_t nearest(Stream stream, uint64_t time, uint64_t& distance) const{
+        auto& values = timestamps[stream];
+        if(values.empty())
+            return noFrame;
+        auto after = std::lower_bound(values.begin(), values.end(), time);
+        size_t index = size_t(after - values.begin());
+        if(after == values.end() || (index > 0 && time - values[index - 1] < *after - time))
+            index--;
+        distance = values[index] > time ? values[index] - time : time - values[index];
+        return index;
+    }
+    //median of the frame intervals, which dropped frames don't move
+    static uint64_t medianPeriod(const std::vector<uint64_t>& values){
+        if(values.size() < 2)
+            return 0;
+        std::vector<uint64_t> periods(values.size() - 1);
+        for(size_t i=1;i<values.size();i++)
+            periods[i - 1] = values[i] - values[i - 1];
+        std::nth_element(periods.begin(), periods.begin() + periods.size()/2, periods.end());
+        return periods[periods.size()/2];
+    }
+public:
+    void clear(){
+        for(auto& values: timestamps)
+            values.clear();
+        timed = false;
+        tickCount = 0;
+        tickPeriod = 0;
+    }
+    //per stream timestamps, empty for streams the recording doesn't have. a stream whose timestamps
+    //go backwards can't be searched, and ticks need strictly increasing ones with a period to take the
+    //tolerance from; the whole recording is paired by index otherwise
+    void build(std::array<std::vector<uint64_t>, STREAM_COUNT> streams){
+        timestamps = std::move(streams);
+        reference = timestamps[COLOR].size() > timestamps[DEPTH].size() ? COLOR : DEPTH;
+        tickCount = timestamps[reference].size();
+        tickPeriod = medianPeriod(timestamps[reference]);
+        auto& ticksAt = timestamps[reference];
+        timed = tickCount > 0 && tickPeriod > 0 &&
+                std::adjacent_find(ticksAt.begin(), ticksAt.end(), std::greater_equal<uint64_t>()) == ticksAt.end();
+        for(auto& values: timestamps)
+            timed = timed && std::is_sorted(values.begin(), values.end());
+        if(!timed)
+            buildByIndex(timestamps[DEPTH].size(), timestamps[COLOR].size(), timestamps[IR].size());
+    }
+    //frame counts only, for recordings read without an index: the old pairing by read order
+    void buildByIndex(size_t depthFrames, size_t colorFrames, size_t irFrames){
+        clear();
+        timestamps[DEPTH].resize(depthFrames);
+        timestamps[COLOR].resize(colorFrames);
+        timestamps[IR].resize(irFrames);
+        reference = depthFrames ? DEPTH : COLOR;
+        tickCount = !depthFrames || !colorFrames ? std::max(depthFrames, colorFrames) : std::min(depthFrames, colorFrames);
+    }
+    bool isTimed() const{
+        return timed;
+    }
+    size_t ticks() const{
+        return tickCount;
+    }
+    Stream referenceStream() const{
+        return reference;
+    }
+    size_t framesOf(Stream stream) const{
+        return timestamps[stream].size();
+    }
+    //microseconds from the first tick, by the nominal period when there are no timestamps
+    uint64_t tickTime(size_t tick, uint64_t periodUs) const{
+        if(!timed)
+            return tick*periodUs;
+        auto& values = timestamps[reference];
+        return values[std::min(tick, tickCount - 1)] - values.front();
+    }
+    //the tick showing at a time from the first one: the last one at or before it
+    size_t tickAt(uint64_t time, uint64_t periodUs) const{
+        if(!tickCount)
+            return 0;
+        if(!timed)
+            return std::min(tickCount - 1, size_t(periodUs ? time/periodUs : 0));
+        auto& values = timestamps[reference];
+        return size_t(std::upper_bound(values.begin(), values.end(), values.front() + time) - values.begin()) - 1;
+    }
+    uint64_t tickTimestamp(size_t tick) const{
+        return timed && tick < tickCount ? timestamps[reference][tick] : 0;
+    }
+    uint64_t tolerance() const{
+        if(toleranceUs)
+            return toleranceUs;
+        return tickPeriod/2;
+    }
+    void setTolerance(uint64_t microseconds){
+        toleranceUs = microseconds;
+    }
+    bool withinTolerance(uint64_t timestamp, size_t tick) const{
+        if(!timed)
+            return true;
+        const uint64_t time = tickTimestamp(tick);
+        return (timestamp > time ? timestamp - time : time - timestamp) <= tolerance();
+    }
+    size_t frameFor(Stream stream, size_t tick) const{
+        if(tick >= tickCount)
+            return noFrame;
+        if(!timed)
+            return tick < timestamps[stream].size() ? tick : noFrame;
+        if(stream == reference)
+            return tick;
+        uint64_t distance = 0;
+        const size_t index = nearest(stream, timestamps[reference][tick], distance);
+        return index != noFrame && distance <= tolerance() ? index : noFrame;
+    }
+    //one pass over every tick, it's only asked for when they're shown
+    driftStats drift(Stream stream) const{
+        driftStats stats;
+        auto& values = timestamps[stream];
+        stats.frames = values.size();
+        if(!timed || values.empty())
+            return stats;
+        const uint64_t limit = tolerance();
+        auto& ticksAt = timestamps[reference];
+        double offsetSum = 0;
+        for(size_t tick=0;tick<tickCount;tick++){
+            uint64_t distance = 0;
+            nearest(stream, ticksAt[tick], distance);
+            if(distance > limit){
+                stats.unmatched++;
+                continue;
+            }
+            stats.matched++;
+            offsetSum += distance;
+            stats.maxOffsetMs = std::max(stats.maxOffsetMs, distance/1000.);
+        }
+        stats.meanOffsetMs = stats.matched ? offsetSum/stats.matched/1000. : 0.;
+        for(size_t i=0;i<std::min(values.size(), tickCount);i++){
+            const uint64_t distance = values[i] > ticksAt[i] ? values[i] - ticksAt[i] : ticksAt[i] - values[i];
+            stats.indexPairingMs = std::max(stats.indexPairingMs, distance/1000.);
+        }
+        //an interval of n periods, give or take half of one, is n - 1 frames missing
+        if(const uint64_t period = medianPeriod(values))
+            for(size_t i=1;i<values.size();i++){
+                const size_t periods = size_t((values[i] - values[i - 1] + period/2)/period);
+                stats.dropped += periods > 1 ? periods - 1 : 0;
+            }
+        return stats;
+    }
+};
+
+#endif // STREAM_SYNC_H
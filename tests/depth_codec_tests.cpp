@@ -0,0 +1,50 @@
+#include "test_check.h"
+#include "depth_codec.h"
+
+#include <random>
+
+//depth the way a sensor gives it: smooth surfaces, edges, holes, and some noise
+static std::vector<uint16_t> syntheticDepth(int width, int height, int stride, uint32_t seed){
+    std::mt19937 random(seed);
+    std::vector<uint16_t> pixels(size_t(stride/2)*height, 0xbeef);
+    for(int y=0;y<height;y++)
+        for(int x=0;x<width;x++){
+            uint16_t& value = pixels[size_t(y)*(stride/2) + x];
+            value = uint16_t(800 + x*3 + y*2 + random() % 5);
+            if(x > width/2 && y < height/3)
+                value += 2500;
+            if(random() % 23 == 0)
+                value = 0;
+        }
+    return pixels;
+}
+
+TEST_CASE(depthCodecRoundTrip){
+    const int sizes[][2] = {{1, 1}, {7, 3}, {33, 5}, {64, 48}, {161, 37}};
+    for(auto& size: sizes){
+        const int width = size[0], height = size[1];
+        for(int padding: {0, 6}){
+            const int stride = (width + padding)*2;
+            auto pixels = syntheticDepth(width, height, stride, uint32_t(width*height + padding));
+            auto encoded = DepthCodec::encode(pixels.data(), width, height, stride);
+            std::vector<uint16_t> decoded(size_t(width)*height);
+            CHECK(DepthCodec::decode(encoded.data(), encoded.size(), decoded.data(), width, height));
+            bool same = true;
+            for(int y=0;y<height;y++)
+                for(int x=0;x<width;x++)
+                    same = same && decoded[size_t(y)*width + x] == pixels[size_t(y)*(stride/2) + x];
+            CHECK(same);
+            //another size is refused, and so is a stream cut short
+            CHECK(!DepthCodec::decode(encoded.data(), encoded.size(), decoded.data(), width + 1, height));
+            CHECK(!DepthCodec::decode(encoded.data(), 4, decoded.data(), width, height));
+            if(width*height > 64)
+                CHECK(!DepthCodec::decode(encoded.data(), encoded.size()/2, decoded.data(), width, height));
+        }
+    }
+    //the extremes go through the escape
+    std::vector<uint16_t> extremes = {0, 65535, 0, 65535, 1, 65534, 32768, 0};
+    auto encoded = DepthCodec::encode(extremes.data(), 4, 2, 8);
+    std::vector<uint16_t> decoded(8);
+    CHECK(DepthCodec::decode(encoded.data(), encoded.size(), decoded.data(), 4, 2));
+    CHECK(decoded == extremes);
+}
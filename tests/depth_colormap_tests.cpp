@@ -0,0 +1,46 @@
+#include "test_check.h"
+#include "depth_colormap.h"
+
+#include <random>
+
+//runs of 16 take the SIMD path, single pixels the scalar one
+static void compareColormap(const DepthColormap& colormap, const std::vector<uint16_t>& depth, const char* name){
+    const size_t counters = size_t(DepthColormap::histogramLanes)*DepthColormap::histogramBins;
+    std::vector<uint32_t> wide(depth.size()), single(depth.size());
+    std::vector<uint32_t> wideHistogram(counters), singleHistogram(counters);
+    colormap.apply(depth.data(), wide.data(), int(depth.size()), wideHistogram.data());
+    for(size_t i=0;i<depth.size();i++){
+        uint32_t histogram[DepthColormap::histogramBins] = {};
+        colormap.apply(&depth[i], &single[i], 1, histogram);
+        singleHistogram[(i % DepthColormap::histogramLanes)*DepthColormap::histogramBins + (depth[i] >> DepthColormap::histogramShift)] +=
+                histogram[depth[i] >> DepthColormap::histogramShift];
+    }
+    if(wide != single)
+        std::printf("colormap %s: SIMD and scalar colors differ\n", name);
+    CHECK(wide == single);
+    CHECK(wideHistogram == singleHistogram);
+    std::vector<uint32_t> unhistogrammed(depth.size());
+    colormap.apply(depth.data(), unhistogrammed.data(), int(depth.size()));
+    CHECK(unhistogrammed == wide);
+}
+
+TEST_CASE(depthColormapSimdMatchesScalar){
+    std::mt19937 random(3);
+    std::vector<uint16_t> depth(16*40 + 11);
+    for(size_t i=0;i<depth.size();i++)
+        depth[i] = i % 17 == 0 ? 0 : uint16_t(i < 64 ? 65535 - i : random() % 12000);
+    DepthColormap colormap;
+    compareColormap(colormap, depth, "default");
+    colormap.setRange(0, 65535);
+    colormap.setPalette(DepthColormap::Palette::JET);
+    compareColormap(colormap, depth, "full range");
+    colormap.setRange(1000, 1001);
+    colormap.setPalette(DepthColormap::Palette::GRAYSCALE);
+    compareColormap(colormap, depth, "narrow range");
+    std::vector<uint8_t> equalization(DepthColormap::histogramBins);
+    for(size_t bin=0;bin<equalization.size();bin++)
+        equalization[bin] = uint8_t(1 + bin*254/equalization.size());
+    colormap.setEqualization(equalization);
+    CHECK(colormap.isEqualized());
+    compareColormap(colormap, depth, "equalized");
+}
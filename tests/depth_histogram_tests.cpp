@@ -0,0 +1,50 @@
+#include "test_check.h"
+#include "depth_histogram.h"
+
+//one frame of a single depth through the colormap pass, as the views count it
+static void showFrame(DepthHistogram& histogram, const DepthColormap& colormap, uint16_t depth, int holes){
+    std::vector<uint16_t> pixels(16*12 + 5, depth);
+    for(int i=0;i<holes;i++)
+        pixels[i*3] = 0;
+    std::vector<uint32_t> colors(pixels.size());
+    colormap.apply(pixels.data(), colors.data(), int(pixels.size()), histogram.frameScratch());
+    histogram.commitFrame();
+}
+
+TEST_CASE(depthHistogramRollingWindow){
+    DepthColormap colormap;
+    DepthHistogram histogram(2);
+    uint16_t nearMm = 0, farMm = 0;
+    CHECK(!histogram.quantileRange(0, 1, nearMm, farMm));
+    //no depth at all isn't a range
+    showFrame(histogram, colormap, 0, 0);
+    CHECK(!histogram.quantileRange(0, 1, nearMm, farMm));
+
+    showFrame(histogram, colormap, 1000, 10);
+    showFrame(histogram, colormap, 2000, 10);
+    CHECK(histogram.quantileRange(0, 1, nearMm, farMm));
+    CHECK(nearMm == 992);
+    CHECK(farMm == 2016);
+    //the window is two frames, the 1000 mm one leaves it
+    showFrame(histogram, colormap, 3000, 0);
+    CHECK(histogram.quantileRange(0, 1, nearMm, farMm));
+    CHECK(nearMm == 2000);
+    CHECK(farMm == 3008);
+    //a frame more of 3000 mm than 2000 mm puts the median in the farther bin
+    CHECK(histogram.quantileRange(0.6, 0.6, nearMm, farMm));
+    CHECK(nearMm == 2992);
+
+    auto table = histogram.equalizationTable();
+    CHECK(table.size() == size_t(DepthHistogram::bins));
+    CHECK(table[0] == 0);
+    CHECK(table[1] == 1);
+    CHECK(table[2000 >> DepthColormap::histogramShift] > 1);
+    CHECK(table[3000 >> DepthColormap::histogramShift] == 255);
+    CHECK(std::is_sorted(table.begin() + 1, table.end()));
+
+    histogram.reset();
+    CHECK(!histogram.quantileRange(0, 1, nearMm, farMm));
+    showFrame(histogram, colormap, 500, 0);
+    CHECK(histogram.quantileRange(0, 1, nearMm, farMm));
+    CHECK(nearMm == 496);
+}
@@ -0,0 +1,40 @@
+#include "test_check.h"
+#include "frame_diff.h"
+
+#include <random>
+
+//whole runs take the AVX2/SSE2 blocks, single values the scalar tail
+TEST_CASE(frameDiffSimdMatchesScalar){
+    std::mt19937 random(9);
+    const int count = 16*20 + 7;
+    std::vector<uint16_t> a(count), b(count);
+    for(int i=0;i<count;i++){
+        a[i] = i % 11 == 0 ? 0 : uint16_t(random());
+        b[i] = i % 13 == 0 ? 0 : uint16_t(i % 3 ? a[i] + random() % 5 : random());
+    }
+    a[1] = 65535;
+    b[1] = 1;
+    std::vector<uint16_t> wide(count), single(count);
+    FrameDiff::depth(a.data(), b.data(), wide.data(), count);
+    for(int i=0;i<count;i++)
+        FrameDiff::depth(&a[i], &b[i], &single[i], 1);
+    CHECK(wide == single);
+    CHECK(wide[0] == 0);
+    CHECK(wide[1] == 65535);
+    a[2] = b[2] = 700;
+    FrameDiff::depth(a.data(), b.data(), wide.data(), count);
+    CHECK(wide[2] == 1);
+
+    std::vector<uint8_t> x(size_t(count)*3), y(x.size());
+    for(size_t i=0;i<x.size();i++){
+        x[i] = uint8_t(random());
+        y[i] = uint8_t(i % 2 ? x[i] ^ (random() & 7) : random());
+    }
+    for(int gainShift: {0, 1, 3, 8}){
+        std::vector<uint8_t> wideColor(x.size()), singleColor(x.size());
+        FrameDiff::color(x.data(), y.data(), wideColor.data(), int(x.size()), gainShift);
+        for(size_t i=0;i<x.size();i++)
+            FrameDiff::color(&x[i], &y[i], &singleColor[i], 1, gainShift);
+        CHECK(wideColor == singleColor);
+    }
+}
@@ -0,0 +1,68 @@
+#include "test_check.h"
+#include "frame_scaler.h"
+
+#include <random>
+
+//the area average written out pixel by pixel, partial blocks dropped
+static std::vector<uint8_t> referenceRgb888(const std::vector<uint8_t>& source, int width, int height, int stride, int factor){
+    const int targetWidth = width/factor, targetHeight = height/factor;
+    std::vector<uint8_t> out(size_t(targetWidth)*3*targetHeight);
+    const uint64_t area = uint64_t(factor)*factor;
+    for(int ty=0;ty<targetHeight;ty++)
+        for(int tx=0;tx<targetWidth;tx++)
+            for(int c=0;c<3;c++){
+                uint64_t sum = 0;
+                for(int y=ty*factor;y<(ty + 1)*factor;y++)
+                    for(int x=tx*factor;x<(tx + 1)*factor;x++)
+                        sum += source[size_t(y)*stride + x*3 + c];
+                out[(size_t(ty)*targetWidth + tx)*3 + c] = uint8_t((sum + area/2)/area);
+            }
+    return out;
+}
+
+static std::vector<uint16_t> referenceDepth(const std::vector<uint16_t>& source, int width, int height, int factor){
+    const int targetWidth = width/factor, targetHeight = height/factor;
+    std::vector<uint16_t> out(size_t(targetWidth)*targetHeight);
+    for(int ty=0;ty<targetHeight;ty++)
+        for(int tx=0;tx<targetWidth;tx++){
+            uint64_t sum = 0, count = 0;
+            for(int y=ty*factor;y<(ty + 1)*factor;y++)
+                for(int x=tx*factor;x<(tx + 1)*factor;x++){
+                    const uint16_t value = source[size_t(y)*width + x];
+                    sum += value;
+                    count += value != 0;
+                }
+            out[size_t(ty)*targetWidth + tx] = uint16_t(count ? (sum + count/2)/count : 0);
+        }
+    return out;
+}
+
+//sizes that leave partial blocks and SIMD tails, and a factor past the old 16 bit column sums
+TEST_CASE(frameScalerMatchesReference){
+    std::mt19937 random(11);
+    const int cases[][3] = {{37, 23, 1}, {64, 48, 2}, {101, 67, 3}, {160, 120, 5}, {621, 302, 300}};
+    for(auto& size: cases){
+        const int width = size[0], height = size[1], factor = size[2];
+        const int targetWidth = width/factor, targetHeight = height/factor;
+
+        const int stride = width*3 + 5;
+        std::vector<uint8_t> rgb(size_t(stride)*height);
+        for(auto& value: rgb)
+            value = uint8_t(random() % 4 ? 255 - random() % 8 : random());
+        std::vector<uint8_t> scaled(size_t(targetWidth)*3*targetHeight);
+        FrameScaler::downscaleRgb888(rgb.data(), width, height, stride, factor, scaled.data(), targetWidth*3);
+        CHECK(scaled == referenceRgb888(rgb, width, height, stride, factor));
+
+        //deep values near the top of the range, holes, and a block without any depth
+        std::vector<uint16_t> depth(size_t(width)*height);
+        for(auto& value: depth)
+            value = random() % 7 == 0 ? 0 : uint16_t(65535 - random() % 2000);
+        for(int y=0;y<factor && y<height;y++)
+            for(int x=0;x<factor && x<width;x++)
+                depth[size_t(y)*width + x] = 0;
+        std::vector<uint16_t> scaledDepth(size_t(targetWidth)*targetHeight, 1);
+        FrameScaler::downscaleDepth(depth.data(), width, height, width*2, factor, scaledDepth.data(), targetWidth*2);
+        CHECK(scaledDepth == referenceDepth(depth, width, height, factor));
+        CHECK(scaledDepth[0] == 0);
+    }
+}
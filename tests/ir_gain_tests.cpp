@@ -0,0 +1,42 @@
+#include "test_check.h"
+#include "ir_gain.h"
+
+#include <random>
+
+//whole runs take the SSE2 steps, single values the scalar tail
+TEST_CASE(irGainSimdMatchesScalar){
+    std::mt19937 random(13);
+    const int count = 8*30 + 5;
+    std::vector<uint16_t> values(count);
+    for(auto& value: values)
+        value = uint16_t(100 + random() % 900);
+    values[17] = 40;
+    values[200] = 65535;//past the sign bit the SSE2 min/max goes through
+
+    uint16_t low = 65535, high = 0;
+    IrGain::range(values.data(), count, low, high);
+    CHECK(low == 40);
+    CHECK(high == 65535);
+    uint16_t singleLow = 65535, singleHigh = 0;
+    for(int i=0;i<count;i++)
+        IrGain::range(&values[i], 1, singleLow, singleHigh);
+    CHECK(singleLow == low);
+    CHECK(singleHigh == high);
+    //only widens what it's given
+    low = 10;
+    high = 20;
+    IrGain::range(values.data(), 8, low, high);
+    CHECK(low == 10);
+
+    for(float gain: {0.f, 0.25f, 255.f/900, 3.7f}){
+        std::vector<uint8_t> wide(count), single(count);
+        IrGain::apply(values.data(), wide.data(), count, 100, gain);
+        for(int i=0;i<count;i++)
+            IrGain::apply(&values[i], &single[i], 1, 100, gain);
+        CHECK(wide == single);
+    }
+    std::vector<uint8_t> out(count);
+    IrGain::apply(values.data(), out.data(), count, 100, 3.7f);
+    CHECK(out[17] == 0);
+    CHECK(out[200] == 255);
+}
@@ -0,0 +1,13 @@
+#include "test_check.h"
+
+int main(){
+    for(auto& test: TestRegistry::tests()){
+        const int before = TestRegistry::failures();
+        test.second();
+        if(TestRegistry::failures() != before)
+            std::printf("%s failed\n", test.first);
+    }
+    const int failures = TestRegistry::failures();
+    std::printf(failures ? "%d failed\n" : "all passed\n", failures);
+    return failures ? 1 : 0;
+}
@@ -0,0 +1,41 @@
+#include "test_check.h"
+#include "overlay_blend.h"
+
+#include <random>
+
+//runs of 6 and more take the SSSE3/SSE2 steps, single pixels the scalar blend
+TEST_CASE(overlayBlendSimdMatchesScalar){
+    std::mt19937 random(5);
+    const int count = 4*50 + 3;
+    std::vector<uint8_t> rgb(size_t(count)*3);
+    std::vector<uint32_t> overlay(count);
+    std::vector<uint16_t> depth(count);
+    for(auto& value: rgb)
+        value = uint8_t(random());
+    for(int i=0;i<count;i++){
+        overlay[i] = 0xff000000u | (random() & 0xffffff);
+        depth[i] = i % 9 == 0 ? 0 : uint16_t(random() % 6000);
+    }
+    depth[1] = 1000;
+    depth[2] = 4000;
+    for(uint32_t alpha: {0u, 1u, 128u, 255u, 256u}){
+        std::vector<uint32_t> wide(count), single(count);
+        OverlayBlend::blendRow(rgb.data(), overlay.data(), depth.data(), wide.data(), count, 1000, 4000, alpha);
+        for(int i=0;i<count;i++)
+            OverlayBlend::blendRow(rgb.data() + i*3, &overlay[i], &depth[i], &single[i], 1, 1000, 4000, alpha);
+        CHECK(wide == single);
+    }
+    //outside near..far, or without depth, the color stays as it is
+    std::vector<uint32_t> out(count);
+    OverlayBlend::blendRow(rgb.data(), overlay.data(), depth.data(), out.data(), count, 1000, 4000, 256);
+    bool plain = true, covered = true;
+    for(int i=0;i<count;i++){
+        const uint32_t color = 0xff000000u | (uint32_t(rgb[i*3]) << 16) | (uint32_t(rgb[i*3 + 1]) << 8) | rgb[i*3 + 2];
+        if(!depth[i] || depth[i] < 1000 || depth[i] > 4000)
+            plain = plain && out[i] == color;
+        else
+            covered = covered && out[i] == (overlay[i] | 0xff000000u);
+    }
+    CHECK(plain);
+    CHECK(covered);
+}
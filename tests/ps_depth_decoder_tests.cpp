@@ -0,0 +1,110 @@
+#include "test_check.h"
+#include "ps_depth_decoder.h"
+
+#include <random>
+
+//the encoder OniFile's writer would have been, using every form the format has: nibble pairs,
+//single nibbles, repeats, and both escapes after 0xff and after a 0xd nibble
+static std::vector<uint8_t> encode16z(const std::vector<uint16_t>& values){
+    std::vector<uint8_t> out;
+    out.push_back(uint8_t(values[0]));
+    out.push_back(uint8_t(values[0] >> 8));
+    auto escape = [&](uint16_t previous, uint16_t value){
+        const int delta = int(previous) - int(value);
+        if(delta >= -64 && delta <= 63)
+            out.push_back(uint8_t(delta + 192));
+        else{
+            out.push_back(uint8_t(value >> 8));
+            out.push_back(uint8_t(value));
+        }
+    };
+    auto nibble = [](uint16_t previous, uint16_t value){
+        const int delta = int(previous) - int(value);
+        return delta >= -6 && delta <= 6 ? delta + 6 : -1;
+    };
+    uint16_t last = values[0];
+    size_t i = 1;
+    while(i < values.size()){
+        size_t run = 0;
+        while(i + run < values.size() && values[i + run] == last)
+            run++;
+        if(run >= 2){
+            const size_t pairs = std::min<size_t>(run/2, 0x1e);
+            out.push_back(uint8_t(0xe0 + pairs));
+            i += pairs*2;
+            continue;
+        }
+        const int high = nibble(last, values[i]);
+        if(high < 0){
+            out.push_back(0xff);
+            escape(last, values[i]);
+            last = values[i++];
+            continue;
+        }
+        if(i + 1 == values.size()){
+            out.push_back(uint8_t((high << 4) | 0x0f));
+            last = values[i++];
+            continue;
+        }
+        const int low = nibble(values[i], values[i + 1]);
+        if(low < 0){
+            out.push_back(uint8_t((high << 4) | 0x0d));
+            escape(values[i], values[i + 1]);
+        }
+        else
+            out.push_back(uint8_t((high << 4) | low));
+        last = values[i + 1];
+        i += 2;
+    }
+    return out;
+}
+
+TEST_CASE(psDepthDecoder16z){
+    std::mt19937 random(7);
+    std::vector<uint16_t> depth(4000);
+    for(size_t i=0;i<depth.size();i++){
+        const size_t segment = i/250;
+        if(segment % 4 == 0)
+            depth[i] = 0;//holes, repeats
+        else if(segment % 4 == 1)
+            depth[i] = uint16_t(1500 + i % 7);//nibble deltas
+        else if(segment % 4 == 2)
+            depth[i] = uint16_t(2000 + random() % 100);//short escapes
+        else
+            depth[i] = uint16_t(random() % 10000);//long escapes
+    }
+    auto encoded = encode16z(depth);
+    std::vector<uint16_t> decoded(depth.size());
+    CHECK(PsDepthDecoder::decode16z(encoded.data(), encoded.size(), decoded.data(), decoded.size()));
+    CHECK(decoded == depth);
+    //short or long of the frame size, and a cut stream, fail the frame
+    CHECK(!PsDepthDecoder::decode16z(encoded.data(), encoded.size(), decoded.data(), decoded.size() - 1));
+    decoded.push_back(0);
+    CHECK(!PsDepthDecoder::decode16z(encoded.data(), encoded.size(), decoded.data(), decoded.size()));
+    decoded.pop_back();
+    CHECK(!PsDepthDecoder::decode16z(encoded.data(), encoded.size() - 1, decoded.data(), decoded.size()));
+    CHECK(!PsDepthDecoder::decode16z(encoded.data(), 1, decoded.data(), decoded.size()));
+
+    //16zT: the same stream over indices, behind a table
+    const std::vector<uint16_t> table = {0, 450, 451, 452, 900, 1800, 3600, 7200};
+    std::vector<uint16_t> indices(1000), expected(indices.size());
+    for(size_t i=0;i<indices.size();i++){
+        indices[i] = uint16_t(i % 100 < 30 ? 0 : (i/3) % table.size());
+        expected[i] = table[indices[i]];
+    }
+    std::vector<uint8_t> tabled = {uint8_t(table.size()), 0};
+    for(uint16_t entry: table){
+        tabled.push_back(uint8_t(entry));
+        tabled.push_back(uint8_t(entry >> 8));
+    }
+    auto values = encode16z(indices);
+    tabled.insert(tabled.end(), values.begin(), values.end());
+    decoded.assign(indices.size(), 0);
+    CHECK(PsDepthDecoder::decode16zWithTable(tabled.data(), tabled.size(), decoded.data(), decoded.size()));
+    CHECK(decoded == expected);
+    //an index off the table, or a table longer than the data
+    tabled[0] = uint8_t(table.size() - 2);
+    CHECK(!PsDepthDecoder::decode16zWithTable(tabled.data(), tabled.size(), decoded.data(), decoded.size()));
+    tabled[0] = 0xff;
+    CHECK(!PsDepthDecoder::decode16zWithTable(tabled.data(), tabled.size(), decoded.data(), decoded.size()));
+}
@@ -0,0 +1,70 @@
+#include "test_check.h"
+#include "stream_sync.h"
+
+static std::vector<uint64_t> timesAt(uint64_t start, uint64_t period, size_t count){
+    std::vector<uint64_t> times(count);
+    for(size_t i=0;i<count;i++)
+        times[i] = start + i*period;
+    return times;
+}
+
+TEST_CASE(streamSyncPairing){
+    //30 fps depth, color starting 5 ms later with frames 10..12 dropped
+    StreamSync sync;
+    auto color = timesAt(5000, 33333, 40);
+    color.erase(color.begin() + 10, color.begin() + 13);
+    sync.build({timesAt(0, 33333, 40), color, {}});
+    CHECK(sync.isTimed());
+    CHECK(sync.referenceStream() == StreamSync::DEPTH);
+    CHECK(sync.ticks() == 40);
+    CHECK(sync.frameFor(StreamSync::DEPTH, 5) == 5);
+    CHECK(sync.frameFor(StreamSync::COLOR, 5) == 5);
+    CHECK(sync.frameFor(StreamSync::COLOR, 20) == 17);
+    CHECK(sync.frameFor(StreamSync::IR, 5) == StreamSync::noFrame);
+    CHECK(sync.frameFor(StreamSync::DEPTH, 40) == StreamSync::noFrame);
+    //half a tick by default: nothing is near the dropped ticks, the 5 ms offset is
+    CHECK(sync.frameFor(StreamSync::COLOR, 11) == StreamSync::noFrame);
+    CHECK(sync.frameFor(StreamSync::COLOR, 13) == 10);
+    sync.setTolerance(4000);
+    CHECK(sync.frameFor(StreamSync::COLOR, 13) == StreamSync::noFrame);
+    sync.setTolerance(10000);
+    CHECK(sync.frameFor(StreamSync::COLOR, 13) == 10);
+    auto stats = sync.drift(StreamSync::COLOR);
+    CHECK(stats.frames == 37);
+    CHECK(stats.dropped == 3);
+    CHECK(stats.matched == 37);
+    CHECK(stats.unmatched == 3);
+    CHECK(stats.maxOffsetMs == 5.);
+    sync.setTolerance(0);
+
+    CHECK(sync.tickTime(0, 33333) == 0);
+    CHECK(sync.tickTime(3, 0) == 99999);
+    CHECK(sync.tickAt(0, 0) == 0);
+    CHECK(sync.tickAt(33332, 0) == 0);
+    CHECK(sync.tickAt(33333, 0) == 1);
+    CHECK(sync.tickAt(uint64_t(1) << 40, 0) == 39);
+
+    //more color frames than depth ones make color the reference
+    sync.build({timesAt(0, 66666, 10), timesAt(0, 33333, 20), {}});
+    CHECK(sync.referenceStream() == StreamSync::COLOR);
+    CHECK(sync.frameFor(StreamSync::DEPTH, 4) == 2);
+
+    //no usable timestamps: zeros, or ones going backwards, pair by index
+    sync.build({std::vector<uint64_t>(10, 0), std::vector<uint64_t>(8, 0), {}});
+    CHECK(!sync.isTimed());
+    CHECK(sync.ticks() == 8);
+    CHECK(sync.frameFor(StreamSync::COLOR, 7) == 7);
+    CHECK(sync.tickAt(100000, 33333) == 3);
+    CHECK(sync.tickTime(3, 33333) == 99999);
+    auto backwards = timesAt(0, 33333, 10);
+    std::swap(backwards[3], backwards[4]);
+    sync.build({backwards, timesAt(0, 33333, 10), {}});
+    CHECK(!sync.isTimed());
+    CHECK(sync.ticks() == 10);
+    sync.build({timesAt(0, 33333, 10), {}, {}});
+    CHECK(sync.isTimed());
+    CHECK(sync.ticks() == 10);
+    sync.buildByIndex(0, 12, 0);
+    CHECK(sync.referenceStream() == StreamSync::COLOR);
+    CHECK(sync.ticks() == 12);
+}
@@ -0,0 +1,37 @@
+#ifndef TEST_CHECK_H
+#define TEST_CHECK_H
+
+#include <cstdio>
+#include <utility>
+#include <vector>
+
+//the few pieces a test file needs: a check that counts failures and goes on, and a registration that
+//lets every file add its tests without main() knowing about them
+struct TestRegistry {
+    static std::vector<std::pair<const char*, void (*)()>>& tests(){
+        static std::vector<std::pair<const char*, void (*)()>> all;
+        return all;
+    }
+    static int& failures(){
+        static int count = 0;
+        return count;
+    }
+    TestRegistry(const char* name, void (*test)()){
+        tests().emplace_back(name, test);
+    }
+};
+
+#define CHECK(condition) \
+    do{ \
+        if(!(condition)){ \
+            std::printf("%s:%d: %s\n", __FILE__, __LINE__, #condition); \
+            TestRegistry::failures()++; \
+        } \
+    }while(0)
+
+#define TEST_CASE(name) \
+    static void name(); \
+    static TestRegistry name##Registered(#name, name); \
+    static void name()
+
+#endif // TEST_CHECK_H
@@ -0,0 +1,26 @@
+# checks of the pure kernels, one file per header: make check here, or from the viewer's build
+TEMPLATE = app
+TARGET = kernel_tests
+
+QT = core
+
+CONFIG += console c++17 testcase
+CONFIG -= app_bundle
+
+SOURCES += \
+    depth_codec_tests.cpp \
+    depth_colormap_tests.cpp \
+    depth_histogram_tests.cpp \
+    frame_diff_tests.cpp \
+    frame_scaler_tests.cpp \
+    ir_gain_tests.cpp \
+    main.cpp \
+    overlay_blend_tests.cpp \
+    ps_depth_decoder_tests.cpp \
+    stream_sync_tests.cpp
+
+HEADERS += \
+    test_check.h
+
+INCLUDEPATH += $$PWD/..
+DEPENDPATH += $$PWD/..
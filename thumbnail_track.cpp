@@ -0,0 +1,269 @@
+#include "thumbnail_track.h"
+#include "frame_scaler.h"
+
+#include <QFile>
+#include <QFileInfo>
+#include <QDataStream>
+
+#include <algorithm>
+#include <chrono>
+#include <iterator>
+
+namespace {
+
+constexpr char sidecarMagic[] = "ONITHB";
+constexpr quint32 sidecarVersion = 1;
+constexpr int rawChunk = 1<<26;//writeRawData takes an int length in Qt 5
+
+qint64 modifiedOf(const QString& path){
+    return QFileInfo(path).lastModified().toMSecsSinceEpoch();
+}
+
+}
+
+ThumbnailTrack::ThumbnailTrack(deviceVStreamInfo& source):
+    source(source), stopping(false), builtSlots(0), plannedSlots(0)
+{}
+
+ThumbnailTrack::~ThumbnailTrack(){
+    stop();
+}
+
+void ThumbnailTrack::start(const QString& path){
+    stop();
+    recordingPath = path;
+    if(!planLevels())
+        return;
+    if(persist && loadSidecar())
+        return;
+    builder = std::thread([this, progressive = source.servesNatively()](){ buildLoop(progressive); });
+}
+
+void ThumbnailTrack::stop(){
+    stopping = true;
+    if(builder.joinable())
+        builder.join();
+    stopping = false;
+    levels.clear();
+    builtSlots = 0;
+    plannedSlots = 0;
+}
+
+//the coarse level is planned first, it's the one that should always cover every frame.
+//sizes come from the recording, cached frames may be downscaled for the views already.
+//a stream the recording doesn't have gets no room in the slots, its thumbnails stay empty
+bool ThumbnailTrack::planLevels(){
+    const size_t framesCount = source.framesCount;
+    const QSize colorSize = source.sourceSize(false);
+    const QSize depthSize = source.sourceSize(true);
+    if(!framesCount || (colorSize.isEmpty() && depthSize.isEmpty()))
+        return false;
+    size_t budgetLeft = defaultBudget;
+    for(int i=int(std::size(levelDivisors))-1;i>=0;i--){
+        level lvl;
+        lvl.divisor = levelDivisors[i];
+        lvl.colorWidth = colorSize.width()/lvl.divisor;
+        lvl.colorHeight = colorSize.height()/lvl.divisor;
+        lvl.depthWidth = depthSize.width()/lvl.divisor;
+        lvl.depthHeight = depthSize.height()/lvl.divisor;
+        if((!colorSize.isEmpty() && (!lvl.colorWidth || !lvl.colorHeight)) ||
+           (!depthSize.isEmpty() && (!lvl.depthWidth || !lvl.depthHeight)))
+            continue;
+        const size_t levelBudget = i ? budgetLeft/2 : budgetLeft;
+        const size_t wanted = framesCount*lvl.slotBytes();
+        lvl.stride = std::max<size_t>(1, (wanted + levelBudget - 1)/std::max<size_t>(1, levelBudget));
+        lvl.slotCount = (framesCount + lvl.stride - 1)/lvl.stride;
+        lvl.storage = std::make_shared<std::vector<uchar>>(lvl.slotCount*lvl.slotBytes());
+        lvl.built = std::shared_ptr<std::atomic<bool>[]>(new std::atomic<bool>[lvl.slotCount]());
+        budgetLeft -= std::min(budgetLeft, lvl.storage->size());
+        plannedSlots += lvl.slotCount;
+        levels.insert(levels.begin(), std::move(lvl));
+    }
+    return !levels.empty();
+}
+
+void ThumbnailTrack::buildLoop(bool progressive){
+    //the cache warm-up reads the file right after opening, reading alongside would only make both seek
+    while(!source.fileProcessing.try_lock()){
+        if(stopping)
+            return;
+        std::this_thread::sleep_for(std::chrono::milliseconds(20));
+    }
+    source.fileProcessing.unlock();
+
+    const size_t framesCount = source.framesCount;
+    const std::vector<size_t> steps = progressive ? std::vector<size_t>{256, 64, 16, 4, 1} : std::vector<size_t>{1};
+    for(size_t pass=0;pass<steps.size();pass++){
+        for(size_t index=0;index<framesCount;index+=steps[pass]){
+            if(stopping)
+                return;
+            if(pass && index % steps[pass - 1] == 0)
+                continue;//visited in the previous pass
+            buildFrame(index);
+        }
+    }
+    if(persist && builtSlots == plannedSlots)
+        saveSidecar();
+}
+
+//a frame that can't be read is skipped, its neighbours stand in for it
+bool ThumbnailTrack::buildFrame(size_t index){
+    std::vector<level*> needed;
+    for(auto& lvl: levels)
+        if(index % lvl.stride == 0 && !lvl.has(index/lvl.stride))
+            needed.push_back(&lvl);
+    if(needed.empty())
+        return true;
+    rawVideoFrame depthFrame, colorFrame;
+    if(!source.readFramePair(index, depthFrame, colorFrame) || !source.expandDepth(depthFrame))
+        return false;
+    //JPEG color is decoded as small as the finest level needed allows, the DCT does that part of the scaling
+    int reduction = 1;
+    if(colorFrame.isCompressed()){
+        for(int candidate: {8, 4, 2}){
+            if(std::all_of(needed.begin(), needed.end(), [candidate](const level* lvl){ return lvl->divisor % candidate == 0; }) &&
+               colorFrame.width % candidate == 0 && colorFrame.height % candidate == 0){
+                reduction = candidate;
+                break;
+            }
+        }
+        if(!source.expandColor(colorFrame, reduction))
+            return false;
+    }
+    source.convertPixels(depthFrame, true);
+    source.convertPixels(colorFrame, false);
+    for(auto lvl: needed){
+        const int colorFactor = lvl->divisor/reduction;
+        if(colorFrame.width/colorFactor != lvl->colorWidth || colorFrame.height/colorFactor != lvl->colorHeight ||
+           depthFrame.width/lvl->divisor != lvl->depthWidth || depthFrame.height/lvl->divisor != lvl->depthHeight)
+            continue;//video mode changed mid-file
+        const size_t slot = index/lvl->stride;
+        uchar* target = lvl->storage->data() + slot*lvl->slotBytes();
+        if(lvl->colorWidth)
+            FrameScaler::downscaleRgb888(colorFrame.data(), colorFrame.width, colorFrame.height, colorFrame.stride,
+                                         colorFactor, target, lvl->colorStride());
+        if(lvl->depthWidth)
+            FrameScaler::downscaleDepth(reinterpret_cast<const uint16_t*>(depthFrame.data()), depthFrame.width, depthFrame.height,
+                                        depthFrame.stride, lvl->divisor, reinterpret_cast<uint16_t*>(target + lvl->colorBytes()),
+                                        lvl->depthStride());
+        lvl->built[slot].store(true, std::memory_order_release);
+        builtSlots++;
+    }
+    return true;
+}
+
+ThumbnailTrack::thumbnail ThumbnailTrack::slotThumbnail(const level& lvl, size_t slot) const{
+    thumbnail result;
+    result.index = int64_t(slot*lvl.stride);
+    uchar* base = lvl.storage->data() + slot*lvl.slotBytes();
+    auto& color = result.frame.color;
+    if(lvl.colorWidth)
+        color.data = std::shared_ptr<uchar>(lvl.storage, base);
+    color.width = lvl.colorWidth;
+    color.height = lvl.colorHeight;
+    color.stride = lvl.colorStride();
+    color.format = QImage::Format_RGB888;
+    auto& depth = result.frame.depth;
+    if(lvl.depthWidth)
+        depth.data = std::shared_ptr<uchar>(lvl.storage, base + lvl.colorBytes());
+    depth.width = lvl.depthWidth;
+    depth.height = lvl.depthHeight;
+    depth.stride = lvl.depthStride();
+    depth.format = QImage::Format_Grayscale16;
+    return result;
+}
+
+//the exact frame from whichever level has it, finest first; otherwise the nearest frame the finest level has
+bool ThumbnailTrack::lookup(int64_t index, thumbnail& result) const{
+    if(index < 0)
+        return false;
+    for(auto& lvl: levels){
+        if(size_t(index) % lvl.stride == 0 && lvl.has(size_t(index)/lvl.stride)){
+            result = slotThumbnail(lvl, size_t(index)/lvl.stride);
+            return true;
+        }
+    }
+    for(auto& lvl: levels){
+        const size_t slot = (size_t(index) + lvl.stride/2)/lvl.stride;
+        if(lvl.has(slot)){
+            result = slotThumbnail(lvl, slot);
+            return true;
+        }
+    }
+    return false;
+}
+
+double ThumbnailTrack::progress() const{
+    return plannedSlots ? double(builtSlots)/plannedSlots : 0.;
+}
+
+//only complete tracks are saved, so loading marks every slot as built
+bool ThumbnailTrack::loadSidecar(){
+    QFile sidecar(sidecarPathFor(recordingPath));
+    if(!sidecar.open(QIODevice::ReadOnly))
+        return false;
+    QDataStream in(&sidecar);
+    in.setByteOrder(QDataStream::LittleEndian);
+
+    QByteArray magic;
+    quint32 version = 0, levelsCount = 0;
+    qint64 storedSize = 0, storedModified = 0, storedFrames = 0;
+    in >> magic >> version >> storedSize >> storedModified >> storedFrames >> levelsCount;
+    if(in.status() != QDataStream::Ok || magic != sidecarMagic || version != sidecarVersion ||
+       storedSize != QFileInfo(recordingPath).size() || storedModified != modifiedOf(recordingPath) ||
+       storedFrames != qint64(source.framesCount) || levelsCount != levels.size())
+        return false;
+    for(auto& lvl: levels){
+        qint32 divisor = 0, colorWidth = 0, colorHeight = 0, depthWidth = 0, depthHeight = 0;
+        qint64 stride = 0;
+        in >> divisor >> stride >> colorWidth >> colorHeight >> depthWidth >> depthHeight;
+        if(in.status() != QDataStream::Ok || divisor != lvl.divisor || stride != qint64(lvl.stride) ||
+           colorWidth != lvl.colorWidth || colorHeight != lvl.colorHeight ||
+           depthWidth != lvl.depthWidth || depthHeight != lvl.depthHeight)
+            return false;
+    }
+    for(auto& lvl: levels){
+        auto data = reinterpret_cast<char*>(lvl.storage->data());
+        for(size_t done=0;done<lvl.storage->size();){
+            int chunk = int(std::min<size_t>(rawChunk, lvl.storage->size() - done));
+            if(in.readRawData(data + done, chunk) != chunk)
+                return false;//slots stay unbuilt, the builder takes over
+            done += chunk;
+        }
+    }
+    for(auto& lvl: levels)
+        for(size_t slot=0;slot<lvl.slotCount;slot++)
+            lvl.built[slot].store(true, std::memory_order_release);
+    builtSlots = size_t(plannedSlots);
+    return true;
+}
+
+bool ThumbnailTrack::saveSidecar() const{
+    const QString sidecarPath = sidecarPathFor(recordingPath);
+    QFile sidecar(sidecarPath);
+    if(!sidecar.open(QIODevice::WriteOnly | QIODevice::Truncate))
+        return false;//read-only location, the track is just built again next time
+    QDataStream out(&sidecar);
+    out.setByteOrder(QDataStream::LittleEndian);
+
+    out << QByteArray(sidecarMagic) << sidecarVersion << QFileInfo(recordingPath).size() << modifiedOf(recordingPath)
+        << qint64(source.framesCount) << quint32(levels.size());
+    for(auto& lvl: levels)
+        out << qint32(lvl.divisor) << qint64(lvl.stride) << qint32(lvl.colorWidth) << qint32(lvl.colorHeight)
+            << qint32(lvl.depthWidth) << qint32(lvl.depthHeight);
+    bool written = out.status() == QDataStream::Ok;
+    for(auto& lvl: levels){
+        auto data = reinterpret_cast<const char*>(lvl.storage->data());
+        for(size_t done=0;written && done<lvl.storage->size();){
+            int chunk = int(std::min<size_t>(rawChunk, lvl.storage->size() - done));
+            written = out.writeRawData(data + done, chunk) == chunk;
+            done += chunk;
+        }
+    }
+    if(!written){
+        sidecar.close();
+        QFile::remove(sidecarPath);
+        return false;
+    }
+    return true;
+}
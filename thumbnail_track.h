@@ -0,0 +1,78 @@
+#ifndef THUMBNAIL_TRACK_H
+#define THUMBNAIL_TRACK_H
+
+#include <QString>
+
+#include <atomic>
+#include <memory>
+#include <thread>
+#include <vector>
+
+#include "device_vstream_info.h"
+
+//small versions of every frame for scrubbing, built in the background once a file is open.
+//two levels: 1/32 scale, meant to cover every frame, and 1/8 scale, which covers every frame as long as
+//its half of the budget allows and every n-th frame otherwise. native files are read in passes of
+//decreasing step, so the whole timeline gets coarse coverage first; OpenNI reads stay sequential since
+//its seeks are expensive. with persistence the finished track goes to <recording>.thumbs
+class ThumbnailTrack {
+public:
+    struct thumbnail{
+        int64_t index = -1;//the frame it was taken from, the nearest one if there's none for the exact frame
+        decodedFrame frame;
+    };
+    static constexpr size_t defaultBudget = size_t(256)<<20;
+
+    explicit ThumbnailTrack(deviceVStreamInfo& source);
+    ~ThumbnailTrack();
+    ThumbnailTrack(const ThumbnailTrack&) = delete;
+    ThumbnailTrack& operator=(const ThumbnailTrack&) = delete;
+
+    //plans the levels from the recorded frame size and starts building, or loads the sidecar when persisting
+    void start(const QString& recordingPath);
+    //stops building and waits for the builder, thumbnails already handed out stay valid
+    void stop();
+    bool lookup(int64_t index, thumbnail& result) const;
+    //0..1, 1 once everything planned is built
+    double progress() const;
+    bool persist = false;
+    static QString sidecarPathFor(const QString& path){
+        return path + ".thumbs";
+    }
+private:
+    struct level{
+        int divisor = 1;
+        size_t stride = 1;//every stride-th frame gets a thumbnail
+        size_t slotCount = 0;
+        int colorWidth = 0, colorHeight = 0;
+        int depthWidth = 0, depthHeight = 0;
+        //rows padded to 4 bytes for QImage
+        int colorStride() const{ return (colorWidth*3 + 3)/4*4; }
+        int depthStride() const{ return (depthWidth*2 + 3)/4*4; }
+        size_t colorBytes() const{ return size_t(colorStride())*colorHeight; }
+        size_t depthBytes() const{ return size_t(depthStride())*depthHeight; }
+        size_t slotBytes() const{ return colorBytes() + depthBytes(); }
+        //color then depth for each slot; shared, so thumbnails on screen outlive a restart
+        std::shared_ptr<std::vector<uchar>> storage;
+        std::shared_ptr<std::atomic<bool>[]> built;
+        bool has(size_t slot) const{ return slot < slotCount && built[slot].load(std::memory_order_acquire); }
+    };
+    static constexpr int levelDivisors[2] = {8, 32};
+
+    deviceVStreamInfo& source;
+    std::vector<level> levels;//finest first
+    std::thread builder;
+    std::atomic<bool> stopping;
+    std::atomic<size_t> builtSlots;
+    size_t plannedSlots;
+    QString recordingPath;
+
+    bool planLevels();
+    void buildLoop(bool progressive);
+    bool buildFrame(size_t index);
+    thumbnail slotThumbnail(const level& lvl, size_t slot) const;
+    bool loadSidecar();
+    bool saveSidecar() const;
+};
+
+#endif // THUMBNAIL_TRACK_H
@@ -0,0 +1,69 @@
+#ifndef VIDEO_WIDGET_H
+#define VIDEO_WIDGET_H
+
+#include <QWidget>
+#include <QPainter>
+#include <QPaintEvent>
+#include <QResizeEvent>
+#include <QElapsedTimer>
+#include <QImage>
+
+#include <cstdint>
+
+#include "device_vstream_info.h"
+
+//plain playback without a scene: the frame is scaled to the widget once, kept for repaints of the same size,
+//and blitted. the scaled copy is already in the screen format, so painting doesn't convert anything
+class VideoWidget : public QWidget {
+    frameBuffer buffer;//keeps the pixels behind image alive
+    QImage image;
+    QImage scaled;//image fitted into the current widget size, null until the next paint needs it
+    QRect target;
+    uint64_t paintNanoseconds;
+    uint64_t paintCount;
+
+    void rescale(){
+        QSize fitted = image.size().scaled(size(), Qt::KeepAspectRatio);
+        target = QRect(QPoint((width() - fitted.width())/2, (height() - fitted.height())/2), fitted);
+        scaled = image.scaled(fitted, Qt::IgnoreAspectRatio, Qt::FastTransformation).convertToFormat(QImage::Format_RGB32);
+    }
+protected:
+    void paintEvent(QPaintEvent*) override{
+        QElapsedTimer timer;
+        timer.start();
+        QPainter painter(this);
+        if(scaled.isNull() && !image.isNull())
+            rescale();
+        painter.fillRect(rect(), Qt::black);
+        if(!scaled.isNull())
+            painter.drawImage(target.topLeft(), scaled);
+        paintNanoseconds += timer.nsecsElapsed();
+        paintCount++;
+    }
+    void resizeEvent(QResizeEvent*) override{
+        scaled = QImage();
+    }
+public:
+    explicit VideoWidget(QWidget* parent = nullptr): QWidget(parent), paintNanoseconds(0), paintCount(0) {
+        setAttribute(Qt::WA_OpaquePaintEvent);
+    }
+    //scaling waits for the paint, frames replaced before that are never scaled at all
+    void setFrame(const frameBuffer& frame){
+        buffer = frame;
+        image = frame.image();
+        scaled = QImage();
+        update();
+    }
+    void clear(){
+        setFrame(frameBuffer());
+    }
+    double averagePaintMs() const{
+        return paintCount ? paintNanoseconds/1e6/paintCount : 0.;
+    }
+    void resetStats(){
+        paintNanoseconds = 0;
+        paintCount = 0;
+    }
+};
+
+#endif // VIDEO_WIDGET_H